@@ -15,6 +15,9 @@
 # include <limits.h>
 # include <unistd.h>
 # include <string.h>
+# include <float.h>
+# include <pthread.h>
+# include <stdarg.h>
 
 # include "grow.h"
 # include "xgrow-tests.h"
@@ -51,10 +54,10 @@ unsigned char ring[256];
 /* Gse of the bond between them is non-zero (regardless of how small).  */
 /* This is hypothetical on i,j being tile n != 0.                       */
 /* CONNECTED is the non-hypothetical version.                           */
-#define HCONNECTED_N(fp,i,j,n) ( (fp->tube->Gse_NS[fp->Cell((i)-1,j)][n]>0) || ( fp->tube->dt_up[n] &&    ( fp->tube->dt_up[n]    == fp->Cell((i)-1,j) ) ) )
-#define HCONNECTED_E(fp,i,j,n) ( (fp->tube->Gse_EW[fp->Cell(i,(j)+1)][n]>0) || ( fp->tube->dt_right[n] && ( fp->tube->dt_right[n] == fp->Cell(i,(j)+1) ) ) )
-#define HCONNECTED_S(fp,i,j,n) ( (fp->tube->Gse_NS[n][fp->Cell((i)+1,j)]>0) || ( fp->tube->dt_down[n] &&  ( fp->tube->dt_down[n]  == fp->Cell((i)+1,j) ) ) )
-#define HCONNECTED_W(fp,i,j,n) ( (fp->tube->Gse_EW[n][fp->Cell(i,(j)-1)]>0) || ( fp->tube->dt_left[n] &&  ( fp->tube->dt_left[n]  == fp->Cell(i,(j)-1) ) ) )
+#define HCONNECTED_N(fp,i,j,n) ( (Gse_NS(fp->tube, fp->Cell((i)-1,j), n)>0) || ( fp->tube->dt_up[n] &&    ( fp->tube->dt_up[n]    == fp->Cell((i)-1,j) ) ) )
+#define HCONNECTED_E(fp,i,j,n) ( (Gse_EW(fp->tube, fp->Cell(i,(j)+1), n)>0) || ( fp->tube->dt_right[n] && ( fp->tube->dt_right[n] == fp->Cell(i,(j)+1) ) ) )
+#define HCONNECTED_S(fp,i,j,n) ( (Gse_NS(fp->tube, n, fp->Cell((i)+1,j))>0) || ( fp->tube->dt_down[n] &&  ( fp->tube->dt_down[n]  == fp->Cell((i)+1,j) ) ) )
+#define HCONNECTED_W(fp,i,j,n) ( (Gse_EW(fp->tube, n, fp->Cell(i,(j)-1))>0) || ( fp->tube->dt_left[n] &&  ( fp->tube->dt_left[n]  == fp->Cell(i,(j)-1) ) ) )
 #endif
 
 #define HCONNECTED(fp,i,j,n) \
@@ -70,7 +73,7 @@ unsigned char ring[256];
 int num_flakes=0;
 int double_tile_count=0;
 int vdouble_tile_count=0;
-flake *blank_flakes = NULL;
+__thread flake *blank_flakes = NULL;  /* per thread, like the pools below [ffs] */
 double k_b = .0019872;
 
 void *calloc_err (size_t nmemb, size_t size) {
@@ -83,42 +86,251 @@ void *calloc_err (size_t nmemb, size_t size) {
    return res;
 }
 
+/*************** per-tube random numbers ****************************/
+
+static int zig_ready=0;
+static void zig_setup(void);
+
+/* fill the state from one 64-bit seed, via splitmix64 */
+void rng_seed(xgrow_rng *rng, unsigned long long seed)
+{
+   int i; unsigned long long z;
+   if (!zig_ready) zig_setup();
+   for (i=0;i<4;i++) {
+      z = (seed += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z>>30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z>>27)) * 0x94d049bb133111ebULL;
+      rng->s[i] = z ^ (z>>31);
+   }
+}
+
+/* advance by 2^128 draws: successive jumps give non-overlapping streams */
+void rng_jump(xgrow_rng *rng)
+{
+   static const unsigned long long J[4] = { 0x180ec6d33cfd0abaULL, 
+      0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+   unsigned long long t[4] = {0,0,0,0};
+   int i,b,k;
+   for (i=0;i<4;i++) for (b=0;b<64;b++) {
+      if (J[i] & (1ULL<<b)) for (k=0;k<4;k++) t[k] ^= rng->s[k];
+      rng_next(rng);
+   }
+   for (k=0;k<4;k++) rng->s[k] = t[k];
+}
+
+/* give child the parent's current stream, and move the parent past it */
+void rng_split(xgrow_rng *parent, xgrow_rng *child)
+{
+   *child = *parent;
+   rng_jump(parent);
+}
+
+/* exponential variates with mean 1, by the Marsaglia-Tsang ziggurat: */
+/* almost always one draw and one multiply, instead of a log().       */
+static unsigned int zig_ke[256];
+static double zig_we[256], zig_fe[256];
+
+static void zig_setup(void)
+{
+   double de=7.697117470131487, te=de, ve=3.949659822581572e-3, q;
+   const double m2=4294967296.0;
+   int i;
+   q = ve/exp(-de);
+   zig_ke[0] = (unsigned int)((de/q)*m2);  zig_ke[1] = 0;
+   zig_we[0] = q/m2;  zig_we[255] = de/m2;
+   zig_fe[0] = 1.0;   zig_fe[255] = exp(-de);
+   for (i=254;i>=1;i--) {
+      de = -log(ve/de+exp(-de));
+      zig_ke[i+1] = (unsigned int)((de/te)*m2);
+      te = de;
+      zig_fe[i] = exp(-de);  zig_we[i] = de/m2;
+   }
+   zig_ready=1;
+}
+
+double rng_exp(xgrow_rng *rng)
+{
+   unsigned long long u = rng_next(rng);
+   unsigned int iz = u & 255, jz = (unsigned int)(u>>32);
+   double x;
+
+   if (!zig_ready) zig_setup();
+   if (jz < zig_ke[iz]) return jz*zig_we[iz];
+   while (1) {
+      if (iz==0) return 7.697117470131487 - log(1.0-rng_uniform(rng));
+      x = jz*zig_we[iz];
+      if (zig_fe[iz] + rng_uniform(rng)*(zig_fe[iz-1]-zig_fe[iz]) < exp(-x)) return x;
+      u = rng_next(rng);  iz = u & 255;  jz = (unsigned int)(u>>32);
+      if (jz < zig_ke[iz]) return jz*zig_we[iz];
+   }
+}
+
+/* each flake lives in one cache-line aligned block:                      */
+/*   top of the rate pyramid | page table | zero_row[] | is_present[] |    */
+/*   tile_sites[] tile_at[] | row_tiles[] col_tiles[] | row pointers       */
+/* everything before the row pointers is zeroed when a flake is recycled. */
+/* the rest of the pyramid and the cell classes are in pages, and rows of */
+/* the cell field are separate, both allocated only where the flake is    */
+/* and kept in pools when it moves on (see page_get and row_touch).       */
+static size_t flake_block_layout(Trep P, Trep N, size_t *pages_at, size_t *zero_at,
+      size_t *present_at, size_t *counts_at, size_t *tallies_at, size_t *rows_at)
+{
+   size_t size = (1<<P), at;  int B = MIN(PAGE_BITS,P);
+   at = RateLevel(P-B+1)*sizeof(double);
+   *pages_at = at;    at += (1UL<<(2*(P-B)))*sizeof(flake_page *);
+   *zero_at = at;     at += (2+size)*sizeof(Trep);
+   at = (at+sizeof(Trep *)-1) & ~(sizeof(Trep *)-1);
+   *present_at = at;  at += present_list_len*sizeof(int);
+   *counts_at = at;   at += 2*(N+1)*sizeof(int);
+   *tallies_at = at;  at += 2*size*sizeof(int);
+   at = (at+sizeof(Trep *)-1) & ~(sizeof(Trep *)-1);
+   *rows_at = at;     at += (2+size)*sizeof(Trep *);
+   return at;
+}
+
+/* the pools are per thread, so tubes can run in threads [ffs] */
+static __thread flake_page *page_pool = NULL;
+static __thread Trep *row_pool[8*sizeof(int)];   /* by P; a free row holds the link */
+
+/* the page below node t of level P-page_bits, made if need be */
+static flake_page *page_get(flake *fp, unsigned long t)
+{
+   flake_page *pg = fp->page[t];
+   if (pg == NULL) {
+      if (page_pool) { pg = page_pool; page_pool = pg->next; pg->next = NULL; }
+      else pg = (flake_page *)calloc_err(1, sizeof(flake_page));
+      fp->page[t] = pg;
+   }
+   return pg;
+}
+
+/* back to the pool; the page must be all zero again */
+static void page_put(flake *fp, unsigned long t)
+{
+   fp->page[t]->next = page_pool;  page_pool = fp->page[t];
+   fp->page[t] = NULL;
+}
+
+/* the off-rate set aside by freeze= at k in page t, or 0 */
+static float frozen_at(flake *fp, unsigned long t, unsigned long k)
+{
+   return (fp->frozen && fp->frozen[t]) ? fp->frozen[t]->rate[k] : 0;
+}
+
+/* the side table of set-aside rates, made the first time it's needed */
+static void frozen_table(flake *fp)
+{
+   if (fp->frozen == NULL) 
+      fp->frozen = (frozen_page **)calloc_err(1UL<<(2*(fp->P-fp->page_bits)), sizeof(frozen_page *));
+}
+
+/* set aside fr at k in page t, keeping the sums; a page of the table */
+/* goes once nothing in it is set aside                               */
+static void frozen_set(flake *fp, unsigned long t, unsigned long k, float fr)
+{
+   frozen_page *fz;  float old = frozen_at(fp,t,k);
+   if (old == fr) return;
+   frozen_table(fp);
+   if ((fz = fp->frozen[t]) == NULL) 
+      fz = fp->frozen[t] = (frozen_page *)calloc_err(1, sizeof(frozen_page));
+   fz->n += (fr!=0) - (old!=0);
+   fp->frozen_rate += (double)fr - old;
+   if (fp->tube) fp->tube->frozen_rate += (double)fr - old;
+   fz->rate[k] = fr;
+   if (fz->n == 0) { free(fz); fp->frozen[t] = NULL; }
+}
+
+/* give cell[] row r storage of its own before it is written */
+static void row_touch(flake *fp, int r)
+{
+   Trep *row;  size_t bytes;
+   if (fp->cell[r] != fp->zero_row) return;
+   if ((row = row_pool[fp->P]) != NULL) row_pool[fp->P] = *(Trep **)row;
+   else {
+      bytes = MAX((2+(1<<fp->P))*sizeof(Trep), sizeof(Trep *));
+      row = (Trep *)malloc(bytes);
+      if (row == NULL) { fprintf(stderr,"Out of memory!\n"); exit(1); }
+   }
+   memset(row, 0, (2+(1<<fp->P))*sizeof(Trep));
+   fp->cell[r] = row;
+}
+
+/* back to the pool once the row is empty */
+static void row_drop(flake *fp, int r)
+{
+   Trep *row = fp->cell[r];
+   if (row == fp->zero_row) return;
+   *(Trep **)row = row_pool[fp->P];  row_pool[fp->P] = row;
+   fp->cell[r] = fp->zero_row;
+}
+
+/* return every row and page the flake holds to the pools */
+static void release_flake_storage(flake *fp)
+{
+   int r, size=(1<<fp->P);  unsigned long t;
+   if (fp->tube) fp->tube->frozen_rate -= fp->frozen_rate;
+   fp->frozen_rate = 0;
+   for (r=0; r<2+size; r++) row_drop(fp,r);
+   for (t=0; t < (1UL<<(2*(fp->P-fp->page_bits))); t++) {
+      if (fp->page[t]) { memset(fp->page[t], 0, sizeof(flake_page)); page_put(fp,t); }
+      if (fp->frozen) free(fp->frozen[t]);
+   }
+   free(fp->frozen);  fp->frozen = NULL;
+}
+
+/* give the flake a fresh, empty block for a 2^P field */
+static void flake_block_init(flake *fp, Trep P)
+{
+   int i;
+   int size = (1<<P);
+   size_t pages_at, zero_at, present_at, counts_at, tallies_at, rows_at, bytes;
+   void *block;
+
+   fp->P = P;
+   bytes = flake_block_layout(P, fp->N, &pages_at, &zero_at, &present_at, &counts_at, 
+         &tallies_at, &rows_at);
+   if (posix_memalign(&block, 64, bytes) != 0) {
+      fprintf(stderr,"Out of memory!\n");
+      exit(1);
+   }
+   memset(block, 0, rows_at);
+   fp->rate = (double *)block;
+   fp->page = (flake_page **)((char *)block + pages_at);
+   fp->page_bits = MIN(PAGE_BITS,P);
+   fp->zero_row = (Trep *)((char *)block + zero_at);
+   fp->cell = (Trep **)((char *)block + rows_at);
+   for (i=0;i<2+size;i++) fp->cell[i] = fp->zero_row;
+   fp->is_present = (int *)((char *)block + present_at);
+   fp->tile_sites = (int *)((char *)block + counts_at);
+   fp->tile_at = fp->tile_sites + fp->N+1;
+   fp->row_tiles = (int *)((char *)block + tallies_at);
+   fp->col_tiles = fp->row_tiles + size;
+   fp->box_i0 = fp->box_j0 = size; fp->box_i1 = fp->box_j1 = -1;
+   fp->live_i0 = fp->live_j0 = 0; fp->live_i1 = fp->live_j1 = size-1;
+   fp->frozen = NULL;  fp->frozen_rate = 0;
+}
+
 /* sets up data structures for a flake -- cell field, hierarchical rates... */
 flake *init_flake(Trep P, Trep N, 
       int seed_i, int seed_j, int seed_n, double Gfc)
 {
-   int i,j,p;
-   int size = (1<<P);
    flake *fp = (flake *)malloc(sizeof(flake));
 
-   fp->P = P; fp->N = N; 
+   fp->N = N; 
 
    //  printf("Making flake %d x %d, %d tiles, seed=%d,%d,%d @ %6.2f\n",
    //         size,size,N,seed_i,seed_j,seed_n,Gfc);
 
-   fp->cell = (Trep **)calloc_err(sizeof(Trep *),2+size);
-   for (i=0;i<2+size;i++) 
-      fp->cell[i]=(Trep *)calloc_err(sizeof(Trep),2+size);
-   fp->rate = (double ***)calloc_err(sizeof(Trep **),P+1);
-   // fp->empty = (int ***)calloc_err(sizeof(int **),P+1);
-
-   for (p=0;p<=P;p++) {
-      size = (1<<p);
-      fp->rate[p]=(double **)calloc_err(sizeof(double *),size);
-      // fp->empty[p]=(int **)calloc_err(sizeof(int *),size);
-      for (i=0;i<size;i++) {
-         fp->rate[p][i]=(double *)calloc_err(sizeof(double),size);
-         // fp->empty[p][i]=(int *)calloc_err(sizeof(int),size);
-         for (j=0;j<size;j++) fp->rate[p][i][j]=0;
-      }
-   }
-   fp->is_present = (int *) calloc_err(sizeof(int),present_list_len);
+   flake_block_init(fp, P);
    fp->flake_conc= (Gfc>0)?exp(-Gfc):0;
    fp->G=0; fp->mismatches=0; fp->tiles=0; fp->events=0;
+   fp->dG_bonds=0; fp->perimeter=0;
    fp->seed_i=seed_i; fp->seed_j=seed_j; fp->seed_n=seed_n;
    fp->flake_ID = 0;  // until it's in a tube
+   fp->origin_i = fp->origin_j = 0;
 
-   fp->next_flake=NULL; fp->tree_node=NULL; fp->tube=NULL;
+   fp->next_flake=NULL; fp->prev_flake=NULL; fp->flake_index=-1; fp->tube=NULL;
+   fp->off=NULL; fp->off_n=0; fp->sites=NULL; fp->sites_n=0;
 
    /* note that empty and rate are correct, because there are no tiles yet */
 
@@ -131,24 +343,13 @@ flake *init_flake(Trep P, Trep N,
 /* returns the next flake in the list */
 flake *free_flake(flake *fp)
 {
-   int i,p; flake *fpn;
-   int size = (1<<fp->P);
-
-   for (i=0;i<2+size;i++) free(fp->cell[i]);
-   free(fp->cell);
+   flake *fpn; int s;
 
-   for (p=0;p<=fp->P;p++) {
-      size = (1<<p);
-      for (i=0;i<size;i++) {
-         free(fp->rate[p][i]);
-         // free(fp->empty[p][i]);
-      }
-      free(fp->rate[p]);
-      // free(fp->empty[p]);
-   }
-   free(fp->rate);
-   // free(fp->empty);
-   free(fp->is_present);
+   release_flake_storage(fp);
+   free(fp->rate);   /* the whole block: page table, is_present, tallies too */
+   for (s=0;s<fp->off_n;s++) free(fp->off[s].cells);
+   for (s=0;s<fp->sites_n;s++) free(fp->sites[s].cells);
+   free(fp->off); free(fp->sites);
 
    fpn=fp->next_flake; free(fp); 
 
@@ -156,39 +357,175 @@ flake *free_flake(flake *fp)
 }
 
 /* for debugging purposes */
-void print_tree(flake_tree *ftp, int L, char s)
-{ int i;
-   for (i=0;i<L;i++) printf(" ");
-   printf("node %d %c (%p): rate %g: L(%p) R(%p) U(%p)\n",
-         L,s,ftp,ftp->rate,
-         ftp->left, ftp->right, ftp->up);
-   if (ftp->left!=NULL) print_tree(ftp->left,L+1,'L');
-   if (ftp->right!=NULL) print_tree(ftp->right,L+1,'R');
-   if (ftp->left==NULL) { 
-      for (i=0;i<=L;i++) printf(" ");
-      printf("flake %d: %d tiles: tree_node(%p)\n",
-            ftp->fp->flake_ID, ftp->fp->tiles, ftp->fp->tree_node);
+void print_tree(tube *tp)
+{ int k;
+   printf("%d flakes in %d slots: total rate %g\n",
+         tp->num_flakes, tp->flake_slots, tp->flake_rates[1]);
+   for (k=0;k<tp->num_flakes;k++)
+      printf(" flake %d: %d tiles: slot %d: rate %g\n",
+            tp->flakes[k]->flake_ID, tp->flakes[k]->tiles, k,
+            tp->flake_rates[tp->flake_slots+k]);
+}
+
+/* recompute the sum tree along the path from flake slot k to the root */
+static void fix_flake_rates(tube *tp, int k)
+{
+   double *rt = tp->flake_rates;
+   for (k=(tp->flake_slots+k)>>1; k>=1; k>>=1) rt[k] = rt[2*k] + rt[2*k+1];
+}
+
+/* recompute tile n's leaf of the on-rate tree, conc[n] times the      */
+/* tube's total of sites where n could attach, and the path above it   */
+static void fix_on_rate(tube *tp, int n)
+{
+   double *t = tp->on_tree, c = tp->conc[n];
+   int k = tp->on_slots+n, sites = tp->tile_fl[n].sites[1];
+   t[k] = (sites && c>0) ? c*sites : 0;
+   for (k>>=1; k>=1; k>>=1) t[k] = t[2*k] + t[2*k+1];
+}
+
+/* the same for the concentration tree, and for the on-rate tree       */
+static void fix_conc(tube *tp, int n)
+{
+   double *t = tp->conc_tree;  int k = tp->on_slots+n;
+   t[k] = MAX(0,tp->conc[n]);
+   for (k>>=1; k>=1; k>>=1) t[k] = t[2*k] + t[2*k+1];
+   fix_on_rate(tp,n);
+}
+
+/* conc[n] (and so conc[0]) goes up by d, as change_cell() depletes    */
+static void add_conc(tube *tp, int n, double d)
+{
+   tp->conc[n] += d;  tp->conc[0] += d;
+   if (d!=0) fix_conc(tp,n);
+}
+
+/* rebuild both trees, after conc[] or the site counts were set       */
+/* wholesale                                                           */
+void reset_conc_trees(tube *tp)
+{
+   int n, k, slots=tp->on_slots;
+   for (k=0; k<slots; k++) tp->conc_tree[slots+k] = tp->on_tree[slots+k] = 0;
+   for (n=1; n<=tp->N; n++) {
+      int sites = tp->tile_fl[n].sites[1];
+      tp->conc_tree[slots+n] = MAX(0,tp->conc[n]);
+      tp->on_tree[slots+n] = (sites && tp->conc[n]>0) ? tp->conc[n]*sites : 0;
    }
+   for (k=slots-1; k>=1; k--) {
+      tp->conc_tree[k] = tp->conc_tree[2*k] + tp->conc_tree[2*k+1];
+      tp->on_tree[k] = tp->on_tree[2*k] + tp->on_tree[2*k+1];
+   }
+}
+
+/* recompute the sum tree along the path from list entry k to the root */
+static void fix_tile_flakes(tile_flakes *tf, int k)
+{
+   int *h = tf->sites;
+   for (k=(tf->cap+k)>>1; k>=1; k>>=1) h[k] = h[2*k] + h[2*k+1];
+}
+
+/* double the capacity of a tile's list of flakes */
+static void grow_tile_flakes(tile_flakes *tf)
+{
+   int k, cap = 2*tf->cap, *h = (int *)calloc_err(sizeof(int),2*cap);
+   for (k=0; k<tf->len; k++) h[cap+k] = tf->sites[tf->cap+k];
+   for (k=cap-1; k>=1; k--) h[k] = h[2*k] + h[2*k+1];
+   free(tf->sites);  tf->sites = h;
+   tf->slot = (int *)realloc(tf->slot, sizeof(int)*cap);  tf->cap = cap;
+}
+
+/* add d to the flake's count in tile n's list: a flake comes into the  */
+/* list when its count leaves 0, and goes when it gets back there, the  */
+/* last one in the list taking its place                                */
+static void add_tile_flakes(tube *tp, flake *fp, int n, int d)
+{
+   tile_flakes *tf = &tp->tile_fl[n];  int k = fp->tile_at[n]-1, last, *h;
+   if (d == 0) return;
+   if (k < 0) {
+      if (tf->len == tf->cap) grow_tile_flakes(tf);
+      k = tf->len++;  tf->slot[k] = fp->flake_index;  fp->tile_at[n] = k+1;
+   }
+   h = tf->sites;  h[tf->cap+k] += d;
+   fix_tile_flakes(tf,k);
+   if (h[tf->cap+k] == 0) {
+      last = --tf->len;
+      if (k != last) {
+         tf->slot[k] = tf->slot[last];  h[tf->cap+k] = h[tf->cap+last];
+         tp->flakes[tf->slot[k]]->tile_at[n] = k+1;
+         h[tf->cap+last] = 0;
+         fix_tile_flakes(tf,k);  fix_tile_flakes(tf,last);
+      }
+      fp->tile_at[n] = 0;
+   }
+}
+
+/* add d to the flake's count of sites for tile n, and to the tube's */
+static void add_tile_sites(flake *fp, int n, int d)
+{
+   tube *tp=fp->tube;
+   fp->tile_sites[n] += d;
+   if (tp==NULL || fp->flake_index<0) return;
+   add_tile_flakes(tp,fp,n,d);
+   fix_on_rate(tp,n);
 }
 
-/* gets rid of the tree nodes, without disturbing the flakes themselves */
-void free_tree(flake_tree *ftp)
+/* enter (d=1) or withdraw (d=-1) all the flake's counts in the tube */
+static void register_tile_sites(flake *fp, int d)
 {
-   if (ftp != NULL) {
-      if (ftp->left!=NULL) free_tree(ftp->left);
-      if (ftp->right!=NULL) free_tree(ftp->right);
-      free(ftp);
+   tube *tp=fp->tube;  int n;
+   for (n=1; n<=fp->N; n++) if (fp->tile_sites[n]) {
+      add_tile_flakes(tp,fp,n,d*fp->tile_sites[n]);
+      fix_on_rate(tp,n);
+   }
+}
+
+/* double the capacity of the flake registry and its sum trees */
+static void grow_flake_registry(tube *tp)
+{
+   int k, slots = 2*tp->flake_slots;
+   double *rt = (double *)calloc_err(sizeof(double),2*slots);
+   flake **fl = (flake **)calloc_err(sizeof(flake *),slots);
+
+   for (k=0;k<tp->num_flakes;k++) {
+      fl[k] = tp->flakes[k];
+      rt[slots+k] = tp->flake_rates[tp->flake_slots+k];
    }
+   for (k=slots-1;k>=1;k--) rt[k] = rt[2*k] + rt[2*k+1];
+   free(tp->flakes); free(tp->flake_rates);
+   tp->flakes = fl; tp->flake_rates = rt; tp->flake_slots = slots;
+}
+
+/* forget all flakes, without touching the flakes themselves */
+/* (they may already have been freed)                        */
+void reset_flake_registry(tube *tp)
+{
+   int k, n;
+   for (k=0;k<tp->flake_slots;k++) tp->flakes[k]=NULL;
+   for (k=0;k<2*tp->flake_slots;k++) tp->flake_rates[k]=0;
+   for (n=1;n<=tp->N;n++) {
+      tp->tile_fl[n].len = 0;
+      memset(tp->tile_fl[n].sites, 0, sizeof(int)*2*tp->tile_fl[n].cap);
+   }
+   tp->num_flakes=0;
+   reset_conc_trees(tp);
 }
 
 /* sets up data structures for tube -- tile set, params, scratch, stats  */
 tube *init_tube(Trep P, Trep N, int num_bindings)
 {
-   int i,j,n,m;
+   int i,j,n;
    int size = (1<<P);
    tube *tp = (tube *)malloc(sizeof(tube));
 
    tp->P = P; tp->N = N; tp->num_bindings = num_bindings;
+   tp->max_P = P;
+   tp->slide_dir = -1; tp->slide_live = 0; tp->slide_fp = NULL; tp->slides = 0;
+   tp->freeze = 0; tp->frozen_rate = 0; tp->frozen_missed = 0;
+   tp->flicker = 0; tp->flickers = 0; tp->flick_fp = NULL;
+   tp->big_size = tp->big_flakes = 0;
+   tp->validate = tp->validate_next = tp->validate_bad = 0;  tp->validate_runs = 0;
+   tp->atam = 0;  tp->atam_front = NULL;  tp->atam_head = tp->atam_cap = 0;
+   tp->atam_n = -1;  tp->atam_events = 0;  tp->atam_nondet = 0;
    tp->hydro=0;  tp->num_flakes=0; tp->total_flakes = 0;
    tp->largest_flake_size = 0;
    tp->all_present=0;
@@ -208,13 +545,14 @@ tube *init_tube(Trep P, Trep N, int num_bindings)
    for (n=0;n<N+1;n++) tp->conc[n]=0;
    tp->Gcb  = (double *)calloc(sizeof(double),N+1);
    for (n=0;n<N+1;n++) tp->Gcb[n]=0;
-   tp->Gse_EW = (double **)calloc(sizeof(double *),N+1);
-   for (n=0;n<N+1;n++) tp->Gse_EW[n]=(double *)calloc(sizeof(double),N+1);
-   for (n=0;n<N+1;n++) for (m=0;m<N+1;m++) tp->Gse_EW[n][m]=0;
-   tp->Gse_NS = (double **)calloc(sizeof(double *),N+1);
-   for (n=0;n<N+1;n++) tp->Gse_NS[n]=(double *)calloc(sizeof(double),N+1);
-   for (n=0;n<N+1;n++) for (m=0;m<N+1;m++) tp->Gse_NS[n][m]=0;
-
+   tp->bond_class = (int *)calloc(sizeof(int),4*(N+1));
+   tp->num_bond_classes = 0;  /* set_Gses() sizes the tables */
+   tp->Gse_bond = NULL; tp->mism_bond = NULL; tp->unit_bond = NULL;
+   tp->off_lazy = 0; tp->off_Gse = 0;
+   tp->num_off_classes = 0; tp->off_cap = 0;
+   tp->off_units = NULL; tp->off_rate = NULL; tp->off_w = NULL; tp->off_hash = NULL;
+
+   rng_seed(&tp->rng,0);  /* callers normally reseed or split into this */
    tp->events=0; tp->t=0; tp->ewrapped=0;
    tp->stat_a=tp->stat_d=tp->stat_h=tp->stat_f=tp->stat_m=0;
    tp->untiltilescount=0;
@@ -225,7 +563,25 @@ tube *init_tube(Trep P, Trep N, int num_bindings)
    tp->Fgroup = (int *)calloc(sizeof(int),size*size);
 
    tp->flake_list=NULL;
-   tp->flake_tree=NULL;
+   tp->flake_slots=1;
+   tp->flakes = (flake **)calloc(sizeof(flake *),tp->flake_slots);
+   tp->flake_rates = (double *)calloc(sizeof(double),2*tp->flake_slots);
+   tp->tile_fl = (tile_flakes *)calloc(sizeof(tile_flakes),N+1);
+   for (n=0;n<=N;n++) {
+      tp->tile_fl[n].cap = 1;
+      tp->tile_fl[n].slot = (int *)calloc(sizeof(int),1);
+      tp->tile_fl[n].sites = (int *)calloc(sizeof(int),2);
+   }
+   for (tp->on_slots=1; tp->on_slots<N+1; tp->on_slots*=2);
+   tp->on_tree = (double *)calloc(sizeof(double),2*tp->on_slots);
+   tp->conc_tree = (double *)calloc(sizeof(double),2*tp->on_slots);
+
+   tp->num_sigs = 0; tp->sigs_cap = 512;
+   tp->sigs = (site_sig *)calloc(sizeof(site_sig),tp->sigs_cap);
+   tp->sig_size = 1024;
+   tp->sig_table = (int *)calloc(sizeof(int),tp->sig_size);
+   tp->sigs_with = (int **)calloc(sizeof(int *),N+1);
+   tp->num_sigs_with = (int *)calloc(sizeof(int),N+1);
 
 
    /* set_params() will have to put reasonable values in place */
@@ -240,20 +596,26 @@ void free_tube(tube *tp)
 
    free(tp->conc);
    free(tp->Gcb);
-   for (n=0;n<tp->N+1;n++) free(tp->Gse_EW[n]);
-   free(tp->Gse_EW);
-   for (n=0;n<tp->N+1;n++) free(tp->Gse_NS[n]);
-   free(tp->Gse_NS);
+   free(tp->bond_class); free(tp->Gse_bond); free(tp->mism_bond); free(tp->unit_bond);
+   free(tp->off_units); free(tp->off_rate); free(tp->off_w); free(tp->off_hash);
 
    free(tp->rv); free(tp->Fgroup); free(tp->Fnext);
 
+   for (i=0;i<tp->num_sigs;i++) free(tp->sigs[i].tiles);
+   free(tp->sigs); free(tp->sig_table);
+   for (n=0;n<=tp->N;n++) free(tp->sigs_with[n]);
+   free(tp->sigs_with); free(tp->num_sigs_with);
+   for (n=0;n<=tp->N;n++) { free(tp->tile_fl[n].slot); free(tp->tile_fl[n].sites); }
+   free(tp->tile_fl); free(tp->on_tree); free(tp->conc_tree);
+   free(tp->atam_front);
+
    for (n=0;n<tp->N+1;n++) free(tp->tileb[n]);
    free(tp->tileb);
    for (i=0;i<tp->num_bindings+1;i++) free(tp->glue[i]);
    free(tp->glue);
    free(tp->strength); 
 
-   free_tree(tp->flake_tree);  
+   free(tp->flakes); free(tp->flake_rates);
 
    fp=tp->flake_list;
    while (fp!=NULL) { fp=free_flake(fp); } 
@@ -262,16 +624,193 @@ void free_tube(tube *tp)
    /* NOTE because init_flake is not safe to out-of-mem, this could die */
 }
 
+/* bond energies are kept per pair of edge bond classes rather than per    */
+/* pair of tiles, so memory is O(N + C^2) where C is about num_bindings.   */
+/* class 0 is the empty tile; class 1+b is bond type b, and 1+B+b is bond  */
+/* type b on a hydrolyzed tile.  the facing edges of double-tile halves    */
+/* get classes of their own, so the pair can be glued together (see the   */
+/* hack below) without affecting anyone else.                              */
 void set_Gses(tube *tp, double Gse, double Gseh) {
-   int n,m;
-   for (n=1; n<=tp->N; n++) for (m=1; m<=tp->N; m++) {
-      tp->Gse_EW[n][m] = ((((tp->tileb)[n][3]==(tp->tileb)[m][1]) * (tp->strength)[(tp->tileb)[m][1]]) +
-            (tp->glue)[(tp->tileb)[n][3]][(tp->tileb)[m][1]]) * (tp->hydro?(((n>tp->N/2 || m>tp->N/2))?Gseh:Gse):Gse);
-      tp->Gse_NS[n][m] = (((tp->tileb)[n][2]==(tp->tileb)[m][0]) * (tp->strength)[(tp->tileb)[m][0]] +
-            (tp->glue)[(tp->tileb)[n][2]][(tp->tileb)[m][0]]) * (tp->hydro?(((n>tp->N/2 || m>tp->N/2))?Gseh:Gse):Gse);
-      if ((tp->dt_right[m] == n) && (tp->Gse_EW[n][m] < 1000)) tp->Gse_EW[n][m] = 1000; // FIXME THIS IS A HACK
-      if ((tp->dt_down[m] == n) && (tp->Gse_NS[m][n] < 1000)) tp->Gse_NS[m][n] = 1000; // FIXME THIS IS A HACK
+   int n,m,d,h,x,y,C,B=tp->num_bindings+1,bx,by;
+   int *base, *hyd;
+   double *G; unsigned char *M;
+
+   C = 1 + B*(tp->hydro?2:1);
+   for (n=1; n<=tp->N; n++) C += 2*((tp->dt_right[n]!=0) + (tp->dt_down[n]!=0));
+   base = (int *)calloc_err(sizeof(int),C);
+   hyd  = (int *)calloc_err(sizeof(int),C);
+   for (h=0; h<=(tp->hydro?1:0); h++) for (x=0; x<B; x++) {
+      base[1+x+B*h] = x; hyd[1+x+B*h] = h;
+   }
+   for (d=0; d<4; d++) tp->bond_class[d] = 0;
+   for (n=1; n<=tp->N; n++) for (d=0; d<4; d++) 
+      tp->bond_class[4*n+d] = 1 + tp->tileb[n][d] + B*(tp->hydro && n>tp->N/2);
+   C = 1 + B*(tp->hydro?2:1);
+#define OWN_CLASS(n,d) if (tp->bond_class[4*(n)+(d)] < 1 + B*(tp->hydro?2:1)) { \
+      x = tp->bond_class[4*(n)+(d)]; base[C] = base[x]; hyd[C] = hyd[x];            \
+      tp->bond_class[4*(n)+(d)] = C++; }
+   for (n=1; n<=tp->N; n++) {
+      if ((m=tp->dt_right[n])) { OWN_CLASS(n,1); OWN_CLASS(m,3); }
+      if ((m=tp->dt_down[n]))  { OWN_CLASS(n,2); OWN_CLASS(m,0); }
+   }
+#undef OWN_CLASS
+
+   if (C != tp->num_bond_classes) {
+      free(tp->Gse_bond); free(tp->mism_bond); free(tp->unit_bond);
+      tp->Gse_bond  = (double *)calloc_err(sizeof(double),C*C);
+      tp->unit_bond = (double *)calloc_err(sizeof(double),C*C);
+      tp->mism_bond = (unsigned char *)calloc_err(sizeof(unsigned char),C*C);
+      tp->num_bond_classes = C;
    }
+   G = tp->Gse_bond; M = tp->mism_bond;
+   for (x=0; x<C; x++) for (y=0; y<C; y++) {
+      if (x==0 || y==0) { G[x*C+y] = 0; M[x*C+y] = 0; tp->unit_bond[x*C+y] = 0; continue; }
+      bx = base[x]; by = base[y];
+      tp->unit_bond[x*C+y] = ((bx==by) * (tp->strength)[by]) + (tp->glue)[bx][by];
+      G[x*C+y] = tp->unit_bond[x*C+y] * ((hyd[x] || hyd[y])?Gseh:Gse);
+      M[x*C+y] = (bx != by && bx*by > 0 && (tp->glue)[bx][by] < min_strength);
+   }
+   for (n=1; n<=tp->N; n++) {
+      if ((m=tp->dt_right[n]) && (Gse_EW(tp,m,n) < 1000)) Gse_EW(tp,m,n) = 1000; // FIXME THIS IS A HACK
+      if ((m=tp->dt_down[n])  && (Gse_NS(tp,n,m) < 1000)) Gse_NS(tp,n,m) = 1000; // FIXME THIS IS A HACK
+   }
+   free(base); free(hyd);
+   reset_site_index(tp);
+   tp->off_Gse = Gse;
+   for (x=0; x<tp->num_off_classes; x++) 
+      tp->off_rate[x] = tp->k * exp(-Gse*tp->off_units[x]);
+   tp->atam_n = -1;  /* [atam] which sites are open may have changed */
+}
+
+/* fill in sp->tiles[] for the signature's neighbours: the tile types */
+/* whose Gse there, evaluated as the Gse() macro would, is > 0 (kTAM)   */
+/* or >= T (aTAM).                                                      */
+static void sig_tiles(tube *tp, site_sig *sp)
+{
+   int n, C = tp->num_bond_classes;  double g;
+   sp->ntiles=0;
+   sp->tiles = (Trep *)calloc(sizeof(Trep),tp->N);
+   for (n=1;n<=tp->N;n++) {
+      g = tp->Gse_bond[BondClass(tp,n,3)*C + sp->nW] + tp->Gse_bond[sp->nE*C + BondClass(tp,n,1)] +
+          tp->Gse_bond[BondClass(tp,n,2)*C + sp->nS] + tp->Gse_bond[sp->nN*C + BondClass(tp,n,0)];
+      if (tp->T>0 ? (g>=tp->T) : (g>0)) sp->tiles[sp->ntiles++]=n;
+   }
+   sp->tiles = (Trep *)realloc(sp->tiles,sizeof(Trep)*MAX(1,sp->ntiles));
+}
+
+/* signatures in order of their neighbours' bond classes, N E S W */
+static int sig_before(tube *tp, int a, int b)
+{
+   site_sig *x = &tp->sigs[a], *y = &tp->sigs[b];
+   if (x->nN != y->nN) return x->nN < y->nN;
+   if (x->nE != y->nE) return x->nE < y->nE;
+   if (x->nS != y->nS) return x->nS < y->nS;
+   return x->nW < y->nW;
+}
+
+/* note that signature id admits each of its tiles.  each list is kept  */
+/* in signature order, not the order the ids were made in, so that which */
+/* site choose_on_event takes doesn't depend on the tube's history      */
+/* [ffs]                                                                 */
+static void sigs_with_add(tube *tp, int id)
+{
+   int t, n, k;
+   for (t=0; t<tp->sigs[id].ntiles; t++) {
+      n = tp->sigs[id].tiles[t];  k = tp->num_sigs_with[n]++;
+      if ((k & (k-1)) == 0)   /* capacity is the next power of 2 */
+         tp->sigs_with[n] = (int *)realloc(tp->sigs_with[n], sizeof(int)*MAX(1,2*k));
+      for (; k>0 && sig_before(tp,id,tp->sigs_with[n][k-1]); k--)
+         tp->sigs_with[n][k] = tp->sigs_with[n][k-1];
+      tp->sigs_with[n][k] = id;
+   }
+}
+
+/* redo every flake's tile_sites[] from its site lists */
+static void recount_tile_sites(tube *tp)
+{
+   flake *fp;  int id, t, n;
+   for (fp=tp->flake_list; fp!=NULL; fp=fp->next_flake) {
+      for (n=1; n<=tp->N; n++) add_tile_sites(fp, n, -fp->tile_sites[n]);
+      for (id=0; id<fp->sites_n; id++) if (fp->sites[id].len) 
+         for (t=0; t<tp->sigs[id].ntiles; t++) 
+            add_tile_sites(fp, tp->sigs[id].tiles[t], fp->sites[id].len);
+   }
+}
+
+/* re-evaluate which tiles each known signature admits.  needed        */
+/* whenever Gse_bond or T may have changed.  signatures are keyed by   */
+/* the bond classes that the four neighbours present to the site,      */
+/* which determine Gse; their ids stay put, so flakes keep their site  */
+/* lists, and only need recounting if some tiles[] actually changed.   */
+void reset_site_index(tube *tp) {
+   int id, n, changed=0;  site_sig *sp;  Trep *old;  int nold;
+   for (id=0; id<tp->num_sigs; id++) {
+      sp = &tp->sigs[id];  old = sp->tiles;  nold = sp->ntiles;
+      sig_tiles(tp,sp);
+      if (nold != sp->ntiles || memcmp(old, sp->tiles, sizeof(Trep)*nold)) changed=1;
+      free(old);
+   }
+   if (!changed) return;
+   for (n=0; n<=tp->N; n++) tp->num_sigs_with[n]=0;
+   for (id=0; id<tp->num_sigs; id++) sigs_with_add(tp,id);
+   recount_tile_sites(tp);
+}
+
+#define SIG_HASH(nN,nE,nS,nW,mask) \
+   ((((((unsigned long)(nN)*1000003UL ^ (nE))*1000003UL ^ (nS))*1000003UL ^ (nW))*2654435761UL >> 7) & (mask))
+
+/* put signature id into the first free slot for its key */
+static void site_sig_insert(tube *tp, int id) {
+   site_sig *sp = &tp->sigs[id];
+   unsigned long h = SIG_HASH(sp->nN,sp->nE,sp->nS,sp->nW,tp->sig_size-1);
+   while (tp->sig_table[h]) h = (h+1) & (tp->sig_size-1);
+   tp->sig_table[h] = id+1;
+}
+
+/* look up (building if necessary) the id of the signature of the empty */
+/* site i,j, given its current neighbours; tp->sigs[id].tiles lists the  */
+/* tile types that could attach there.                                  */
+/* returns -1 if the site has no neighbours at all.                     */
+/* 0 <= i,j < 2^P                                                       */
+static int sig_lookup(tube *tp, int nN, int nE, int nS, int nW);
+
+int site_signature(flake *fp, int i, int j)
+{
+   tube *tp=fp->tube;
+   return sig_lookup(tp, BondClass(tp,fp->Cell(i-1,j),2), BondClass(tp,fp->Cell(i,j+1),3),
+         BondClass(tp,fp->Cell(i+1,j),0), BondClass(tp,fp->Cell(i,j-1),1));
+}
+
+/* the same, given the bond classes the neighbours present */
+static int sig_lookup(tube *tp, int nN, int nE, int nS, int nW)
+{
+   site_sig *sp;  unsigned long h;  int id;
+
+   if (nN==0 && nE==0 && nS==0 && nW==0) return -1;
+
+   h = SIG_HASH(nN,nE,nS,nW,tp->sig_size-1);
+   for (; (id=tp->sig_table[h]); h = (h+1) & (tp->sig_size-1)) {
+      sp = &tp->sigs[id-1];
+      if (sp->nN==nN && sp->nE==nE && sp->nS==nS && sp->nW==nW) return id-1;
+   }
+
+   /* new signature */
+   if (tp->num_sigs == tp->sigs_cap) {
+      tp->sigs_cap *= 2;
+      tp->sigs = (site_sig *)realloc(tp->sigs, sizeof(site_sig)*tp->sigs_cap);
+   }
+   id = tp->num_sigs++;
+   sp = &tp->sigs[id];
+   sp->nN=nN; sp->nE=nE; sp->nS=nS; sp->nW=nW;
+   sig_tiles(tp,sp);
+   sigs_with_add(tp,id);
+
+   if (2*tp->num_sigs > tp->sig_size) {   /* keep load factor <= 1/2 */
+      free(tp->sig_table);  tp->sig_size *= 2;
+      tp->sig_table = (int *)calloc_err(sizeof(int),tp->sig_size);
+      for (h=0; h<tp->num_sigs; h++) site_sig_insert(tp,h);
+   } else site_sig_insert(tp,id);
+   return id;
 }
 
 
@@ -309,6 +848,7 @@ void set_params(tube *tp, int** tileb, double* strength, double **glue, double*
    for (n=1; n <= tp->N; n++) 
       tp->conc[0]+=
          (tp->conc[n]=exp(-((n>tp->N/2&&tp->hydro)?Gmch:Gmc))*stoic[n]);
+   reset_conc_trees(tp);
    if (anneal_t && Gse < anneal_g) {
       fprintf(stderr,"Final Gse must be larger than initial Gse for an anneal.\n");
       exit(-1);
@@ -357,6 +897,12 @@ void set_params(tube *tp, int** tileb, double* strength, double **glue, double*
       }
    }
    tp->tinybox = tinybox;
+
+   /* anneals change Gse many times, so keep off-rates by strength class */
+   tp->off_lazy = (tp->anneal_t || tp->seconds_per_C) && !tp->hydro && 
+      tp->T==0 && fission_allowed!=F_CHUNK;
+   for (n=1; n <= tp->N; n++) 
+      if (dt_right[n] || dt_left[n] || dt_down[n] || dt_up[n]) tp->off_lazy = 0;
    tp->default_seed_i = seed_i;
    tp->default_seed_j = seed_j;
    tp->initial_Gfc = Gfc;
@@ -365,7 +911,7 @@ void set_params(tube *tp, int** tileb, double* strength, double **glue, double*
    for (n=0; n <= tp->N; n++) tp->Gcb[n]=0;
    if (tp->hydro) for (n=tp->N/2+1; n <= tp->N; n++) tp->Gcb[n]=Ghyd;
 
-   /* set Gse_EW Gse_NS from Gse, Gseh rules */
+   /* set Gse_bond from Gse, Gseh rules */
    /* uses (tp->tileb)[] and tp->strength[] and tp->glue[] */
    /* XXX We will want to modify this */  /* See also (change also!) reset_params */
    set_Gses(tp,Gse,Gseh);
@@ -390,7 +936,7 @@ void set_params(tube *tp, int** tileb, double* strength, double **glue, double*
 /* BUG: if conc's go to zero, log returns nan                       */
 void recalc_G(flake *fp)
 {
-   int n,i,j,size=(1<<fp->P), oldmm;  tube *tp=fp->tube;
+   int n,i,j,i0,i1,j0,j1,size=(1<<fp->P), oldmm;  tube *tp=fp->tube;
    oldmm = fp->mismatches;
    fp->G = 0; fp->mismatches=0; fp->tiles=0;
    /* OLD: don't count the seed tile concentration */
@@ -399,7 +945,8 @@ void recalc_G(flake *fp)
    /* add up all tile's entropy, bond energy, and hydrolysis energy */
    /* while we're at it, make sure 'mismatches' is correct          */
    /* and re-evaluate all off-rate & hydrolysis rates               */
-   for (i=0;i<size;i++) for(j=0;j<size;j++) {
+   flake_box(fp,1,&i0,&i1,&j0,&j1);
+   for (i=i0;i<=i1;i++) for(j=j0;j<=j1;j++) {
       if ((n=fp->Cell(i,j))>0) {
          if (tp->conc[n]<=fp->flake_conc) { dprintf("Zero concentration in recalc_G for tile %d at %d, %d\n", n, i, j); fp->G += 0; }
          else if (tp->dt_right[n]) fp->G += -log(tp->conc[n]) - Gse_double(fp,i,j,n)/2.0 - tp->Gcb[n];
@@ -415,36 +962,39 @@ void recalc_G(flake *fp)
    }
    fp->mismatches/=2;
    tp->stat_m = fp->mismatches - oldmm;
+   fp->dG_bonds = calc_dG_bonds(fp);
    update_tube_rates(fp);
 } // recalc_G()
 
 /* calculate the dG of the flake, excluding concentration effects */
 double calc_dG_bonds(flake *fp)
 {
-   int n,i,j,size=(1<<fp->P);  tube *tp=fp->tube;
+   int n,i,j,i0,i1,j0,j1,size=(1<<fp->P);  tube *tp=fp->tube;
    double dG=0;
 
    /* add up bond energy and hydrolysis energy only */
-   for (i=0;i<size;i++)
-      for(j=0;j<size;j++) {
+   flake_box(fp,0,&i0,&i1,&j0,&j1);
+   for (i=i0;i<=i1;i++)
+      for(j=j0;j<=j1;j++) {
          if ((n=fp->Cell(i,j))>0) {
-            if (tp->dt_right[n]) fp->G += - Gse_double(fp,i,j,n)/2.0 - tp->Gcb[n];
-            else if (tp->dt_down[n]) fp->G += - Gse_vdouble(fp,i,j,n)/2.0 - tp->Gcb[n];
-            else if ( (!tp->dt_left[n]) && (!tp->dt_up[n]) ) fp->G += - Gse(fp,i,j,n)/2.0 - tp->Gcb[n];
+            if (tp->dt_right[n]) dG += - Gse_double(fp,i,j,n)/2.0 - tp->Gcb[n];
+            else if (tp->dt_down[n]) dG += - Gse_vdouble(fp,i,j,n)/2.0 - tp->Gcb[n];
+            else if ( (!tp->dt_left[n]) && (!tp->dt_up[n]) ) dG += - Gse(fp,i,j,n)/2.0 - tp->Gcb[n];
          }
       }
-   return dG; // FIXME: DOES THIS ACTUALLY WORK?
+   return dG;
 } // calc_dG_bonds()
 
 /* calculate the perimeter of the flake */
 int calc_perimeter(flake *fp)
 {
-   int n,i,j,size=(1<<fp->P); 
+   int n,i,j,i0,i1,j0,j1; 
    int perimeter=0;
 
    /* add up number of empty cells next to this one */
-   for (i=0;i<size;i++)
-      for(j=0;j<size;j++) {
+   flake_box(fp,0,&i0,&i1,&j0,&j1);
+   for (i=i0;i<=i1;i++)
+      for(j=j0;j<=j1;j++) {
          if ((n=fp->Cell(i,j))>0) {
             perimeter += (fp->Cell(i-1,j)==0)+(fp->Cell(i+1,j)==0)+
                (fp->Cell(i,j-1)==0)+(fp->Cell(i,j+1)==0);
@@ -453,10 +1003,33 @@ int calc_perimeter(flake *fp)
    return perimeter;
 } // calc_perimeter()
 
+/* compare the incrementally kept perimeter, dG_bonds and mismatches   */
+/* with a full recount; report and return the number that disagree.    */
+/* (after error_radius_flake, 'mismatches' means something else.)      */
+int check_flake_stats(flake *fp)
+{
+   int n,i,j,i0,i1,j0,j1, mm=0, perimeter, bad=0;
+   double dG;
+
+   perimeter = calc_perimeter(fp);  dG = calc_dG_bonds(fp);
+   flake_box(fp,0,&i0,&i1,&j0,&j1);
+   for (i=i0;i<=i1;i++)
+      for(j=j0;j<=j1;j++)
+         if ((n=fp->Cell(i,j))>0) mm += Mism(fp,i,j,n);
+   mm/=2;
+   if (perimeter != fp->perimeter) { bad++;
+      fprintf(stderr,"flake %d: perimeter is %d, kept as %d\n",fp->flake_ID,perimeter,fp->perimeter); }
+   if (fabs(dG - fp->dG_bonds) > 1e-6*(1+fabs(dG))) { bad++;
+      fprintf(stderr,"flake %d: dG_bonds is %f, kept as %f\n",fp->flake_ID,dG,fp->dG_bonds); }
+   if (mm != fp->mismatches) { bad++;
+      fprintf(stderr,"flake %d: mismatches is %d, kept as %d\n",fp->flake_ID,mm,fp->mismatches); }
+   return bad;
+} // check_flake_stats()
+
 
 void reset_params(tube *tp, double old_Gmc, double old_Gse, 
       double new_Gmc, double new_Gse, double Gseh)
-{  int n;
+{  int n, doubles=0;
    flake *fp;
 
    if (!(tp->hydro)) {         /* not clear what to do for hydro rules */
@@ -476,27 +1049,35 @@ void reset_params(tube *tp, double old_Gmc, double old_Gse,
       tp->conc[0]=0;  
       for (n=1; n <= tp->N; n++) 
          tp->conc[0]+= (tp->conc[n]*=exp(-(new_Gmc-old_Gmc)));
+      reset_conc_trees(tp);
 
+      /* off-rates don't depend on conc[], so if only Gmc changed,    */
+      /* just each tile's -log(conc) term of G                          */
+      /* moves (double tiles count once, so leave them to recalc_G)    */
+      for (n=1; n <= tp->N; n++) doubles += (tp->dt_right[n] || tp->dt_down[n]);
       for (fp=tp->flake_list; fp!=NULL; fp=fp->next_flake) {
          fp->flake_conc*=exp(-(new_Gmc-old_Gmc));
+         if (new_Gse==old_Gse && doubles==0) {
+            fp->G += fp->tiles*(new_Gmc-old_Gmc);
+            continue;
+         }
          //    printf("\nPrior Params recalc_G(#%d)\n",fp->flake_ID);
-         //             print_tree(tp->flake_tree,0,'*');  
+         //             print_tree(tp);  
          recalc_G(fp);
          //    printf("\nReset Params recalc_G(#%d)\n",fp->flake_ID);
-         //             print_tree(tp->flake_tree,0,'*');  
+         //             print_tree(tp);  
 
       }
    }
 } // reset_params()
 
-/* put flake in the binary tree, somewhat balancing rates       */
-/* (more principled would be to build Huffman tree bottom-up)   */
+/* put flake in the registry and the sum tree, and on the list */
 /* Note: tp->conc[0] & tp->k must be valid, to calculate rates. */
 /* fp->rate and fp->empty must be non-zero for the same reason, */
 /* hence recalc_G is used to update rates based on tube params. */
 void insert_flake(flake *fp, tube *tp)
 {
-   double rate; flake_tree *ftp, *ftpL, *ftpR;
+   int k;
 
    if (fp->N != tp->N || fp->P != tp->P) {
       printf("flake and tube incompatible!!\n"); exit(1);
@@ -505,74 +1086,39 @@ void insert_flake(flake *fp, tube *tp)
 
    fp->tube=tp; recalc_G(fp); 
 
+   /* register the flake, and enter its rates in the sum trees */
+   if (tp->num_flakes == tp->flake_slots) grow_flake_registry(tp);
+   k = tp->num_flakes++;
+   tp->flakes[k] = fp; fp->flake_index = k;
+   update_tube_rates(fp);
+   /* reset_flake_registry() may have left it thinking it's in the lists */
+   memset(fp->tile_at, 0, sizeof(int)*(fp->N+1));
+   register_tile_sites(fp,+1);
 
-   rate  = fp->rate[0][0][0];
-
-   /* If the flake_tree is empty, make the root. */
-   if (tp->flake_tree==NULL) {
-      ftp = (flake_tree *)malloc(sizeof(flake_tree));
-      ftp->left=ftp->right=NULL; ftp->fp=fp; ftp->up=NULL;
-      ftp->rate=rate;
-      tp->flake_tree=ftp;
-      fp->tree_node=ftp;
-   } else {
-      ftp = tp->flake_tree;
-      while (1) {
-	if (ftp->fp!=NULL || (ftp->rate < rate)) {  // FIXME FIXME: removed empty
-            ftpL = (flake_tree *)malloc(sizeof(flake_tree));
-            ftpL->rate=ftp->rate; 
-            ftpL->fp=ftp->fp; ftpL->left=ftp->left; ftpL->right=ftp->right;
-            ftpL->up=ftp;
-            if (ftp->fp!=NULL) ftp->fp->tree_node=ftpL;
-
-            ftpR = (flake_tree *)malloc(sizeof(flake_tree));
-            ftpR->rate=rate; 
-            ftpR->fp=fp; ftpR->left=ftpR->right=NULL;
-            ftpR->up=ftp;
-            fp->tree_node=ftpR;
-
-            ftp->rate+=rate; 
-            ftp->left=ftpL; ftp->right=ftpR; ftp->fp=NULL;
-
-            break;
-         } else if (ftp->left->rate < 
-               ftp->right->rate) {
-            ftp->rate+=rate; 
-            ftp=ftp->left;
-         } else {
-            ftp->rate+=rate; 
-            ftp=ftp->right;
-         }
-      }
-   }  
+   fp->prev_flake=NULL;
    fp->next_flake=tp->flake_list;
+   if (tp->flake_list!=NULL) tp->flake_list->prev_flake=fp;
    tp->flake_list=fp;
    fp->flake_ID=++tp->total_flakes;
-   tp->num_flakes++;
+   tp->atam_n = -1;  /* [atam] its sites aren't in the frontier yet */
 } // insert_flake()
 
 void add_flake_to_reserve_list(flake *fp) {
-   int p, i, j;
-   int size;
-   // First clear flake
-   size = (1<< (fp->P));
-   for (i=0;i<2+size;i++) 
-      memset(fp->cell[i],0,2+size*sizeof(Trep));
-   for (p=0;p<=fp->P;p++) {
-      size = (1<<p);
-      for (i=0;i<size;i++) {
-         //memset(fp->empty[p][i],size,sizeof(int));      
-         for (j=0;j<size;j++) {
-	   //fp->empty[p][i][j]=0;
-            fp->rate[p][i][j]=0;
-         }
-      }
-   }
-   for (p=0; p<present_list_len; p++) {
-      fp->is_present[p] = 0;
-   }
+   size_t pages_at, zero_at, present_at, counts_at, tallies_at, rows_at;
+   int s;
+   // First clear flake: rows and pages go back to their pools, then
+   // the rest of the rates, is_present and tallies in one go
+   release_flake_storage(fp);
+   flake_block_layout(fp->P, fp->N, &pages_at, &zero_at, &present_at, &counts_at, 
+         &tallies_at, &rows_at);
+   memset(fp->rate, 0, rows_at);
+   for (s=0; s<fp->off_n; s++) fp->off[s].len = fp->off[s].count = 0;
+   for (s=0; s<fp->sites_n; s++) fp->sites[s].len = fp->sites[s].count = 0;
+   fp->box_i0 = fp->box_j0 = (1<<fp->P); fp->box_i1 = fp->box_j1 = -1;
+   fp->live_i0 = fp->live_j0 = 0; fp->live_i1 = fp->live_j1 = (1<<fp->P)-1;
    fp->G=0; fp->mismatches=0; fp->tiles=1; fp->events=0;
-   fp->tree_node = NULL;
+   fp->dG_bonds=0; fp->perimeter=0;
+   fp->flake_index = -1; fp->prev_flake = NULL;
    fp->next_flake = blank_flakes;
    blank_flakes = fp;
 }
@@ -602,71 +1148,215 @@ flake * recover_flake (int seed_i, int seed_j, int seed_n, double Gfc) {
    quickly, the tree should be rebalanced again soon.  */
 void remove_flake(flake *fp) {
    tube *tp;
-   flake_tree *ftp, *tmp, *u;
-   flake *f;
+   int k, n, last;  flake *lp;
 
    tp=fp->tube;
+   k = fp->flake_index;
+   assert (k >= 0 && tp->flakes[k] == fp);
+   register_tile_sites(fp,-1);
+   tp->frozen_rate -= fp->frozen_rate;  fp->frozen_rate = 0;
    fp->tube = NULL;
-   ftp = fp->tree_node;
-   assert (ftp != NULL);
-   u = ftp->up;
-   if (u) {
-      /* Get rid of the node in the tree and merge the other child with
-         the parent*/
-      if (u->right == ftp) {
-         tmp = u->left;
-      }
-      else {
-         assert (u->left == ftp);
-         tmp = u->right;
-      }
-      u->fp = tmp->fp;
-      if (u->fp) {
-         u->fp->tree_node = u;
-      }
-      u->rate = tmp->rate;
-      //u->empty = tmp->empty;
-      u->right = tmp->right;
-      if (u->right) {
-         u->right->up = u;
-      }
-      u->left = tmp->left;
-      if (u->left) { 
-         u->left->up = u;
-      }
-      free (tmp);
-      /* Now propagate the rate change up the tree */
-      u = u->up;
-      while (u) {
-         //u->rate -= ftp->rate;
-         //u->empty -= ftp->empty;
-         u->rate = u->left->rate + u->right->rate;
-	 // u->empty = u->left->empty + u->right->empty;
-         u = u->up;
-      }
+   /* move the last registered flake into this slot */
+   last = --tp->num_flakes;
+   if (k != last) {
+      lp = tp->flakes[k] = tp->flakes[last];
+      lp->flake_index = k;
+      for (n=1; n<=tp->N; n++)   /* its places in the tile lists stay */
+         if (lp->tile_at[n]) tp->tile_fl[n].slot[lp->tile_at[n]-1] = k;
+      tp->flake_rates[tp->flake_slots+k] = tp->flake_rates[tp->flake_slots+last];
+      fix_flake_rates(tp,k);
    }
-   else {
-      /* Tree is now empty */
-      tp->flake_tree = NULL;
-   }
-   free (ftp);
+   tp->flakes[last] = NULL;
+   tp->flake_rates[tp->flake_slots+last] = 0;
+   fix_flake_rates(tp,last);
+   tp->atam_n = -1;  /* [atam] its sites may be in the frontier */
    // Remove the flake from the flake list
-   if (fp == tp->flake_list) {
-      tp->flake_list = fp->next_flake;
+   if (fp->prev_flake != NULL) fp->prev_flake->next_flake = fp->next_flake;
+   else tp->flake_list = fp->next_flake;
+   if (fp->next_flake != NULL) fp->next_flake->prev_flake = fp->prev_flake;
+   add_flake_to_reserve_list(fp);
+   //free_flake (fp);
+}
+
+/* move the flake into a fresh 2^P field, its tiles and seed shifted by */
+/* di,dj; tiles that land outside the field are dropped.  the flake     */
+/* keeps its place in the tube (pointer, list links, registry slot);    */
+/* the tiles are put back with the tube unhooked, so concentrations and */
+/* stats aren't touched, and recalc_G then redoes the rates, classes    */
+/* and site counts.  the live box is whatever it is set to by then.     */
+static void move_flake(flake *fp, int di, int dj, int live_i0, int live_i1,
+      int live_j0, int live_j1)
+{
+   tube *tp=fp->tube;
+   int i,j,i0,i1,j0,j1,k,m=0,s,stat_m,*at,*keep;  Trep *tn;
+
+   register_tile_sites(fp,-1);
+   flake_box(fp,0,&i0,&i1,&j0,&j1);
+   k = MAX(1,(i1-i0+1)*(j1-j0+1));
+   at = (int *)calloc_err(sizeof(int),2*k);  tn = (Trep *)calloc_err(sizeof(Trep),k);
+   for (i=i0;i<=i1;i++) for (j=j0;j<=j1;j++) 
+      if (fp->Cell(i,j)) { at[2*m]=i; at[2*m+1]=j; tn[m++]=fp->Cell(i,j); }
+   keep = (int *)calloc_err(sizeof(int),MAX(1,present_list_len));
+   memcpy(keep, fp->is_present, present_list_len*sizeof(int));
+
+   release_flake_storage(fp);
+   free(fp->rate);
+   for (s=0; s<fp->off_n; s++) fp->off[s].len = fp->off[s].count = 0;
+   for (s=0; s<fp->sites_n; s++) fp->sites[s].len = fp->sites[s].count = 0;
+   flake_block_init(fp, tp->P);
+   memcpy(fp->is_present, keep, present_list_len*sizeof(int));
+   fp->live_i0 = live_i0;  fp->live_i1 = live_i1;
+   fp->live_j0 = live_j0;  fp->live_j1 = live_j1;
+
+   fp->tube = NULL;  fp->perimeter = 0;
+   for (k=0; k<m; k++) change_cell(fp, at[2*k]+di, at[2*k+1]+dj, tn[k]);
+   fp->seed_i += di;  fp->seed_j += dj;
+   fp->origin_i -= di;  fp->origin_j -= dj;
+   fp->tube = tp;
+   stat_m = tp->stat_m;  recalc_G(fp);  tp->stat_m = stat_m;
+
+   free(at); free(tn); free(keep);
+}
+
+/* double the field, with the old one in the middle of the new: every  */
+/* flake is moved over, and so are the fill scratch arrays and the      */
+/* place where tinybox starts new flakes.  blank flakes in reserve, and */
+/* pooled rows, are of the old size, so they are let go.               */
+void expand_tube(tube *tp)
+{
+   int n, size, shift=(1<<tp->P)/2;  flake *fp;  Trep *row;
+
+   while (blank_flakes) blank_flakes = free_flake(blank_flakes);
+   while ((row = row_pool[tp->P]) != NULL) { row_pool[tp->P] = *(Trep **)row; free(row); }
+
+   tp->P++;  size=(1<<tp->P);
+   free(tp->Fnext); free(tp->Fgroup);
+   tp->Fnext = (int *)calloc_err(sizeof(int),size*size);
+   for (n=0;n<size*size;n++) tp->Fnext[n]=-1;
+   tp->Fgroup = (int *)calloc_err(sizeof(int),size*size);
+   tp->default_seed_i += shift;  tp->default_seed_j += shift;
+
+   for (fp=tp->flake_list; fp!=NULL; fp=fp->next_flake) 
+      move_flake(fp,shift,shift,0,size-1,0,size-1);
+   tp->atam_n = -1;
+}
+
+/* give back what this thread's pools hold, before it goes [ffs] */
+void free_pools(void)
+{
+   int P;  Trep *row;  flake_page *pg;
+   while (blank_flakes) blank_flakes = free_flake(blank_flakes);
+   while ((pg = page_pool) != NULL) { page_pool = pg->next; free(pg); }
+   for (P=0; P<8*sizeof(int); P++)
+      while ((row = row_pool[P]) != NULL) { row_pool[P] = *(Trep **)row; free(row); }
+}
+
+/* true if the flake is within a few cells of the edge of its field; */
+/* a double tile can stretch the box by 2 in one event.              */
+#define EXPAND_MARGIN 4
+static int flake_cramped(flake *fp)
+{
+   int size=(1<<fp->P);
+   if (fp->box_i0 > fp->box_i1) return 0;
+   return fp->box_i0 < EXPAND_MARGIN || fp->box_j0 < EXPAND_MARGIN ||
+      fp->box_i1 >= size-EXPAND_MARGIN || fp->box_j1 >= size-EXPAND_MARGIN;
+}
+
+/* [slide] the moving window.  tp->slide_dir is the side the flakes grow */
+/* towards (0=N 1=E 2=S 3=W).  once a front comes within EXPAND_MARGIN  */
+/* of that side, everything more than tp->slide_live rows (or columns)  */
+/* behind the front is written to tp->slide_fp and dropped, except for  */
+/* the row next to the live ones, which stays as a frozen substrate:    */
+/* its tiles hold on to their bonds but have no events of their own     */
+/* (see Frozen), and fission fills count them as part of the seed.  the */
+/* window then moves back so that row is on the trailing edge.          */
+static int flake_at_front(flake *fp)
+{
+   int size=(1<<fp->P);
+   if (fp->box_i0 > fp->box_i1) return 0;
+   switch (fp->tube->slide_dir) {
+      case 0: return fp->box_i0 < EXPAND_MARGIN;
+      case 1: return fp->box_j1 >= size-EXPAND_MARGIN;
+      case 2: return fp->box_i1 >= size-EXPAND_MARGIN;
+      case 3: return fp->box_j0 < EXPAND_MARGIN;
    }
-   else {
-      for (f = tp->flake_list; f != NULL; f = f->next_flake) {
-         if (f->next_flake == fp) {
-            f->next_flake = fp->next_flake;
-            break;
-         }
+   return 0;
+}
+
+/* cells i0..i1 x j0..j1 as one MATLAB-format block, headed by the flake */
+/* and the position of its top left cell in the starting field           */
+static void write_cells(FILE *out, char *mode, int n, flake *fp, 
+      int i0, int i1, int j0, int j1)
+{
+   int i,j;
+   fprintf(out,"\n%s{%d}={ [ %d %d %d ],...\n  [",
+         mode,n,fp->flake_ID,i0+fp->origin_i,j0+fp->origin_j);
+   for (i=i0;i<=i1;i++) {
+      for (j=j0;j<=j1;j++) fprintf(out," %d",fp->Cell(i,j));
+      fprintf(out,"; ...\n");
+   }
+   fprintf(out," ] };\n");
+}
+
+static void slide_flake(flake *fp)
+{
+   tube *tp=fp->tube;
+   int size=(1<<fp->P), L=tp->slide_live, d=tp->slide_dir;
+   int i,j,i0,i1,j0,j1,f,di=0,dj=0,best=-1,dist;
+   int si0,si1,sj0,sj1, li0=0,li1=size-1,lj0=0,lj1=size-1;
+
+   /* f is the row or column that stays, frozen; s.. is what goes */
+   flake_box(fp,0,&i0,&i1,&j0,&j1);
+   si0=i0; si1=i1; sj0=j0; sj1=j1;
+   if (d==0)      { f=MIN(i0+L,size-1); si0=f+1; di=size-1-f; li1=size-2; }
+   else if (d==2) { f=MAX(i1-L,0);      si1=f-1; di=-f;       li0=1; }
+   else if (d==1) { f=MAX(j1-L,0);      sj1=f-1; dj=-f;       lj0=1; }
+   else           { f=MIN(j0+L,size-1); sj0=f+1; dj=size-1-f; lj1=size-2; }
+   if (si0<=si1 && sj0<=sj1) {
+      write_cells(tp->slide_fp,"slide",++tp->slides,fp,si0,si1,sj0,sj1);
+      fflush(tp->slide_fp);
+   }
+
+   /* a seed that would go is moved to the kept tile nearest the cut */
+   i=fp->seed_i+di; j=fp->seed_j+dj;
+   if (i<0 || i>=size || j<0 || j>=size) {
+      int bi=0, bj=0;
+      for (i=i0;i<=i1;i++) for (j=j0;j<=j1;j++) {
+         if (fp->Cell(i,j)==0 || i+di<0 || i+di>=size || j+dj<0 || j+dj>=size) continue;
+         dist = (d==0||d==2) ? size*abs(i-f) + abs(j-fp->seed_j) 
+            : size*abs(j-f) + abs(i-fp->seed_i);
+         if (best<0 || dist<best) { best=dist; bi=i; bj=j; }
       }
+      fp->seed_i=bi; fp->seed_j=bj; fp->seed_n=fp->Cell(bi,bj);
    }
-   add_flake_to_reserve_list(fp);
-   //free_flake (fp);
-   tp->num_flakes--;
+   move_flake(fp,di,dj,li0,li1,lj0,lj1);
 }
 
+/* at the end of a run: the part of each flake still in the window, so */
+/* that with the slide{} blocks before it the whole flake can be put   */
+/* back together                                                        */
+void write_slide_windows(tube *tp)
+{
+   flake *fp;  int n=0, i0,i1,j0,j1;
+   if (tp->slide_fp==NULL) return;
+   for (fp=tp->flake_list; fp!=NULL; fp=fp->next_flake) {
+      flake_box(fp,0,&i0,&i1,&j0,&j1);
+      if (i0<=i1) write_cells(tp->slide_fp,"window",++n,fp,i0,i1,j0,j1);
+   }
+   fflush(tp->slide_fp);
+}
+
+/* [kernel] the hot path -- calc_rates, update_rates, change_cell and   */
+/* simulate -- is compiled twice from one source: as is, and for plain  */
+/* runs (see plain_kernel), where the tests for everything else fold    */
+/* away because 'plain' is a constant.  the public functions are the    */
+/* generic variant; simulate() picks one each time it is called.        */
+#if defined(__GNUC__)
+#define KERNEL static inline __attribute__((always_inline))
+#else
+#define KERNEL static inline
+#endif
+
 /* gives concentration-independent rates                                   */
 /* for non-empty cells i,j, computes rate rv[n] to convert to type n       */
 /*  so rv[0] gives the off-rate  (not the sum)                             */
@@ -676,7 +1366,7 @@ void remove_flake(flake *fp) {
 /* for empty cells i,j, returns 0                                          */
 /* rv must already exist, of size at least fp->N+1 (+4 for chunks)         */
 /* 0 <= i,j < 2^P                                                          */
-double calc_rates(flake *fp, int i, int j, double *rv)
+KERNEL double calc_rates_k(flake *fp, int i, int j, double *rv, const int plain)
 {
    int n,mi,ei,hi,mo,eo,ho;
    double r, sumr; 
@@ -688,24 +1378,11 @@ double calc_rates(flake *fp, int i, int j, double *rv)
    if (rv!=NULL) for (n=0;n<=N+4;n++) rv[n]=0;
    if (tp==NULL) return 0;
    n = fp->Cell(i,j);
-   if (tp->T>0 && n!=0) return 0;   
-   if (tp->T>0 && n==0) {
-        /* calculate how many tile types could make >= T bonds */
-        //FIXME breaks for doubles?
-      r=0;
-      for (n=1;n<=fp->N;n++)
-         if (Gse(fp,i,j,n)>=tp->T) r += tp->k*tp->conc[n];
-      return r;  /* only care if exists */
-   }
-   if (n==0) {
-      r=0;
-      for (n=1;n<=fp->N;n++)
-         if (Gse(fp,i,j,n)>0) r += tp->k*tp->conc[n];
-      return r;  /* only care if exists */
-   }
-   if (tp->dt_left[n]) return 0;                 /* similarly, no off-rate for the  
+   if (!plain && tp->T>0 && n!=0) return 0;   
+   if (n==0) return 0;  /* on-rates are kept by site signature; see update_rates */
+   if (!plain && tp->dt_left[n]) return 0;       /* similarly, no off-rate for the  
                                                     right side of a double tile */
-   if (tp->dt_up[n]) return 0;                 /* similarly, no off-rate for the  
+   if (!plain && tp->dt_up[n]) return 0;       /* similarly, no off-rate for the  
                                                     bottom side of a vdouble tile */
    // NOTE: w/o wander, seed site can't dissociate.  So set rate to zero.
    //       w/  wander, seed site can dissociate if there is a neighbor to
@@ -713,12 +1390,12 @@ double calc_rates(flake *fp, int i, int j, double *rv)
    // Similarly, for chunk_fission, we must zero the rates for seedchunks,
    // unless wander is on -- in which case we zero the rates if there are
    // no neighbors to move the seed to.  This is done below.
-   seedchunk[0] = (i   == fp->seed_i && j   == fp->seed_j) || 
+   seedchunk[0] = (i   == fp->seed_i && j   == fp->seed_j) || (!plain && (
       (i == fp->seed_i && ((tp->dt_right[fp->seed_n] && j == fp->seed_j + 1)  ||
                            (tp->dt_left[fp->seed_n] && j == fp->seed_j - 1)))    ||
       (j == fp->seed_j && ((tp->dt_down[fp->seed_n] && i == fp->seed_i + 1)  ||
-                           (tp->dt_up[fp->seed_n] && i == fp->seed_i - 1)));
-   if (!tp->dt_right[n] && !tp->dt_down[n]) {
+                           (tp->dt_up[fp->seed_n] && i == fp->seed_i - 1)))));
+   if (plain || (!tp->dt_right[n] && !tp->dt_down[n])) {
       r = tp->k * exp(-Gse(fp,i,j,n));
    } 
    else if (tp->dt_down[n]) {
@@ -727,11 +1404,11 @@ double calc_rates(flake *fp, int i, int j, double *rv)
    else {
       r = tp->k * exp(-Gse_double(fp,i,j,n));
    } 
-   if (seedchunk[0] && (!wander || fp->tiles==1 || (fp->tiles==2 && fp->seed_is_double_tile) || (fp->tiles==2 && fp->seed_is_vdouble_tile)))
+   if (seedchunk[0] && (plain || !wander || fp->tiles==1 || (fp->tiles==2 && fp->seed_is_double_tile) || (fp->tiles==2 && fp->seed_is_vdouble_tile)))
       r=0; 
 
    sumr=r;
-   if (fission_allowed==2) {              // rates for pairs and 2x2 block dissoc
+   if (!plain && fission_allowed==2) {              // rates for pairs and 2x2 block dissoc
       if (rv!=NULL) rv[1+N+0]=r;
       seedchunk[1] = (i   == fp->seed_i && j+1 == fp->seed_j) || seedchunk[0];
       seedchunk[2] = (i+1 == fp->seed_i && j   == fp->seed_j) || seedchunk[0];
@@ -753,7 +1430,7 @@ double calc_rates(flake *fp, int i, int j, double *rv)
    if (rv!=NULL) rv[0]=sumr; 
 
    /*  hydrolysis model assumes tiles 1...N/2 non hydrolyzed, N/2+1...N hydro */
-   if (tp->hydro) {
+   if (!plain && tp->hydro) {
       /*
          for "hydrolysis" of tile n -> n+N/2, for n = 1...N/2 
          and for "dehydrolysis"   n -> n-N/2, for n = N/2+1...N
@@ -798,8 +1475,157 @@ double calc_rates(flake *fp, int i, int j, double *rv)
    } 
 
    return sumr;
-} // calc_rates()
+} // calc_rates_k()
+
+double calc_rates(flake *fp, int i, int j, double *rv)
+{
+   return calc_rates_k(fp,i,j,rv,0);
+}
+
+
+/* for tube->off_lazy: occupied cells are grouped into classes by their */
+/* total bond strength u in units of Gse, so that every cell of class s  */
+/* has off-rate off_rate[s] = k exp(-Gse u).  class numbers are shared   */
+/* by all flakes in the tube, and made up as new values of u turn up.    */
+#define Unit_bond(tp,c1,c2) ((tp)->unit_bond[(c1)*(tp)->num_bond_classes + (c2)])
+#define OFF_HASH(u,mask) ((unsigned long)(((u)*0x9e3779b97f4a7c15ULL) >> 40) & (mask))
+
+/* as Gse(fp,i,j,n), but in units of Gse */
+static double cell_units(flake *fp, int i, int j, Trep n)
+{
+   tube *tp=fp->tube;
+   return Unit_bond(tp, BondClass(tp,n,3), BondClass(tp,fp->Cell(i,j-1),1)) +
+      Unit_bond(tp, BondClass(tp,fp->Cell(i,j+1),3), BondClass(tp,n,1)) +
+      Unit_bond(tp, BondClass(tp,n,2), BondClass(tp,fp->Cell(i+1,j),0)) +
+      Unit_bond(tp, BondClass(tp,fp->Cell(i-1,j),2), BondClass(tp,n,0));
+}
+
+static void off_hash_insert(tube *tp, int s)
+{
+   unsigned long long b;  unsigned long h, mask=2*tp->off_cap-1;
+   memcpy(&b, &tp->off_units[s], sizeof(b));
+   for (h=OFF_HASH(b,mask); tp->off_hash[h]; h=(h+1)&mask) ;
+   tp->off_hash[h] = s+1;
+}
 
+static int off_class_of(tube *tp, double u)
+{
+   unsigned long long b;  unsigned long h;  int s;
+
+   memcpy(&b, &u, sizeof(b));
+   if (tp->off_cap) 
+      for (h=OFF_HASH(b,2*tp->off_cap-1); (s=tp->off_hash[h]); h=(h+1)&(2*tp->off_cap-1))
+         if (tp->off_units[s-1]==u) return s-1;
+
+   if (tp->num_off_classes == tp->off_cap) {   /* keep load factor <= 1/2 */
+      tp->off_cap = MAX(16, 2*tp->off_cap);
+      tp->off_units = (double *)realloc(tp->off_units, sizeof(double)*tp->off_cap);
+      tp->off_rate = (double *)realloc(tp->off_rate, sizeof(double)*tp->off_cap);
+      tp->off_w = (double *)realloc(tp->off_w, sizeof(double)*(tp->off_cap+1));
+      free(tp->off_hash);
+      tp->off_hash = (int *)calloc_err(sizeof(int), 2*tp->off_cap);
+      for (s=0; s<tp->num_off_classes; s++) off_hash_insert(tp,s);
+   }
+   s = tp->num_off_classes++;
+   tp->off_units[s] = u;  tp->off_rate[s] = tp->k * exp(-tp->off_Gse*u);
+   off_hash_insert(tp,s);
+   return s;
+}
+
+/* make sure *lists has at least n entries; new ones are empty */
+static void cell_lists_reserve(cell_list **lists, int *have, int n)
+{
+   if (n <= *have) return;
+   *lists = (cell_list *)realloc(*lists, sizeof(cell_list)*n);
+   memset(*lists + *have, 0, sizeof(cell_list)*(n - *have));
+   *have = n;
+}
+
+/* the page holding cell x (i*2^P+j), and x's index k within it */
+static flake_page *cell_page(flake *fp, int x, int *k)
+{
+   unsigned long m = Morton(x >> fp->P, x & ((1<<fp->P)-1));
+   *k = m & ((1UL<<(2*fp->page_bits))-1);
+   return fp->page[m >> (2*fp->page_bits)];
+}
+
+/* take cell x, at k in page pg, out of whichever class it is in, if any */
+static void cell_class_drop(flake *fp, flake_page *pg, int k)
+{
+   int c=pg->cell_class[k], q=pg->cell_slot[k]-1, y, t, ky;
+   cell_list *cl;
+
+   if (c==0) return;
+   if (c>0) cl = &fp->off[c-1];
+   else {
+      site_sig *sp = &fp->tube->sigs[-c-1];
+      cl = &fp->sites[-c-1];
+      for (t=0; t<sp->ntiles; t++) add_tile_sites(fp, sp->tiles[t], -1);
+   }
+   cl->count--;
+   if (q>=0) {   /* move the last listed cell into its place */
+      y = cl->cells[--cl->len];  cl->cells[q] = y;  
+      cell_page(fp,y,&ky)->cell_slot[ky] = q+1;
+   }
+   pg->cell_class[k] = 0;  pg->cell_slot[k] = 0;  pg->used--;
+}
+
+/* put cell x, at k in page pg, in list cl, which cell_class[] knows as c */
+static void cell_class_add(flake_page *pg, int k, int x, cell_list *cl, int c, int listed)
+{
+   cl->count++;
+   pg->cell_class[k] = c;  pg->cell_slot[k] = 0;  pg->used++;
+   if (listed) {
+      if (cl->len == cl->cap) {
+         cl->cap = MAX(8, 2*cl->cap);
+         cl->cells = (int *)realloc(cl->cells, sizeof(int)*cl->cap);
+      }
+      cl->cells[cl->len++] = x;  pg->cell_slot[k] = cl->len;
+   }
+}
+
+/* file the empty site x under its signature id */
+static void site_class_add(flake *fp, flake_page *pg, int k, int x, int id)
+{
+   site_sig *sp;  int t;
+   cell_lists_reserve(&fp->sites, &fp->sites_n, fp->tube->num_sigs);
+   cell_class_add(pg, k, x, &fp->sites[id], -(id+1), 1);
+   sp = &fp->tube->sigs[id];
+   for (t=0; t<sp->ntiles; t++) add_tile_sites(fp, sp->tiles[t], +1);
+}
+
+/* file the occupied cell x under off-rate class s */
+static void off_class_add(flake *fp, flake_page *pg, int k, int x, int s, int listed)
+{
+   cell_lists_reserve(&fp->off, &fp->off_n, fp->tube->num_off_classes);
+   cell_class_add(pg, k, x, &fp->off[s], s+1, listed);
+}
+
+/* off-event rate of the flake: its pyramid plus its off-rate classes */
+static double flake_rate(flake *fp)
+{
+   double r = fp->Rate(0,0,0);  int s;
+   for (s=0; s<fp->off_n; s++) r += fp->off[s].len * fp->tube->off_rate[s];
+   return r;
+}
+
+/* move an off_lazy tube to a new Gse.  on-rates only depend on the sign */
+/* of Gse, so just the class rates, G, and the flake totals change; that */
+/* costs O(# classes) per flake instead of a recalc_G() of every cell.   */
+static void anneal_Gse(tube *tp, double Gse)
+{
+   flake *fp;  int s;  double old_Gse = tp->off_Gse, bonds;
+
+   set_Gses(tp,Gse,0);  // NOT SAFE FOR HYDROLYSIS
+   if (!tp->off_lazy || old_Gse<=0 || Gse<=0) { update_all_rates(tp); return; }
+   for (fp = tp->flake_list; fp != NULL; fp=fp->next_flake) {
+      bonds = 0;   /* each bond is seen from both of its tiles */
+      for (s=0; s<fp->off_n; s++) bonds += fp->off[s].count * tp->off_units[s];
+      fp->G -= (Gse-old_Gse)*bonds/2;
+      fp->dG_bonds -= (Gse-old_Gse)*bonds/2;
+      update_tube_rates(fp);
+   }
+}
 
 /* figure the delta_rate for this cell, and propagate up.           */
 /* note: as long as hierarchy is accurate w/r to contents,          */
@@ -816,52 +1642,318 @@ double calc_rates(flake *fp, int i, int j, double *rv)
 /*   is(are) a tile type(s) that could be added at the location.    */
 /* Assumes that ii,jj can be anything -- boundary conditions are    */
 /*   taken care of here.                                            */
-void update_rates(flake *fp, int ii, int jj)
+KERNEL void update_rates_k(flake *fp, int ii, int jj, const int plain)
 {
-   int p; int size=(1<<fp->P);
+   int p; int size=(1<<fp->P); tube *tp=fp->tube;
 
    // wrap in case ii,jj go beyond the central field of 1-cell protection zone
-   if (periodic) { ii=(ii+size)%size; jj=(jj+size)%size; }
+   if (!plain && periodic) { ii=(ii+size)%size; jj=(jj+size)%size; }
 
    if (!(ii < 0 || ii >= size || jj < 0 || jj >= size)) {
-      fp->rate[fp->P][ii][jj] = calc_rates(fp, ii, jj, NULL);
-      for (p=fp->P-1; p>=0; p--) {
-         ii = (ii>>1); jj = (jj>>1);
-         fp->rate[p][ii][jj] = fp->rate[p+1][ii<<1][jj<<1]   +
-            fp->rate[p+1][ii<<1][(jj<<1)+1] +
-            fp->rate[p+1][(ii<<1)+1][jj<<1] +
-            fp->rate[p+1][(ii<<1)+1][(jj<<1)+1];
+      int B = fp->page_bits, l;
+      unsigned long m = Morton(ii,jj), t = m >> (2*B), c;
+      unsigned long k = m & ((1UL<<(2*B))-1);
+      int x = (ii<<fp->P) + jj;  Trep n = fp->Cell(ii,jj);  double r=0;  float fr=0;
+      flake_page *pg = fp->page[t];
+      if (tp!=NULL) {
+         if (pg) cell_class_drop(fp,pg,k);
+         if (Frozen(fp,ii,jj)) ;   /* left behind by the window [slide] */
+         else if (n==0) {   /* on-events are counted per tile type, by signature */
+            int id = site_signature(fp,ii,jj);
+            if (id>=0) site_class_add(fp,pg=page_get(fp,t),k,x,id);
+         } else {
+            r = calc_rates_k(fp, ii, jj, NULL, plain);
+            if (tp->off_lazy) {
+               /* the off-rate is carried by the cell's strength class; */
+               /* r==0 means it can't dissociate (the seed), but counts */
+               off_class_add(fp, pg=page_get(fp,t), k, x, 
+                     off_class_of(tp,cell_units(fp,ii,jj,n)), r>0);
+               r = 0;
+            }
+            else if (tp->freeze>0 && fp->flake_index>=0 && 
+                  r < tp->freeze*tp->flake_rates[tp->flake_slots+fp->flake_index]) {
+               fr = r;  r = 0;   /* set aside until a neighbour changes [freeze] */
+            }
+         }
       }
+      if (fr!=0 || fp->frozen) frozen_set(fp,t,k,fr);
+      if (pg==NULL && r==0) return;   /* a page that isn't there is all 0 */
+      if (pg==NULL) pg = page_get(fp,t);
+      /* an unchanged leaf leaves every sum above it as it was */
+      if (pg->rate[PageLevel(B)+k] != r) {
+         pg->rate[PageLevel(B)+k] = r;
+         for (l=B-1; l>=1; l--) {
+            c = PageLevel(l+1) + (k & ~3UL);  k = (k>>2);
+            pg->rate[PageLevel(l)+k] = 
+               pg->rate[c] + pg->rate[c+1] + pg->rate[c+2] + pg->rate[c+3];
+         }
+         m = t;
+         fp->rate[RateLevel(fp->P-B)+m] = pg->rate[0] + pg->rate[1] + pg->rate[2] + pg->rate[3];
+         for (p=fp->P-B-1; p>=0; p--) {
+            c = RateLevel(p+1) + (m & ~3UL);  m = (m>>2);
+            fp->rate[RateLevel(p)+m] = 
+               fp->rate[c] + fp->rate[c+1] + fp->rate[c+2] + fp->rate[c+3];
+         }
+      }
+      /* rates are >= 0, so a zero sum means the whole subtree is zero */
+      if (pg->used==0 && fp->rate[RateLevel(fp->P-B)+t]==0) 
+         page_put(fp,t);
    }
-   if (fp->rate[0][0][0] < 0) printf("ERROR: fp->rate[0][0][0] < 0 in update_rates.\n");
-} // update_rates()
+} // update_rates_k()
+
+void update_rates(flake *fp, int ii, int jj)
+{
+   update_rates_k(fp,ii,jj,0);
+}
+
+static void update_rates_plain(flake *fp, int ii, int jj)
+{
+   update_rates_k(fp,ii,jj,1);
+}
 
 void update_tube_rates(flake *fp)
 {
-   flake_tree *ftp=fp->tree_node; 
-   double oldrate, newrate; 
+   tube *tp=fp->tube;
 
-   if (ftp==NULL) return;
+   if (tp==NULL || fp->flake_index<0) return;
 
-   oldrate = ftp->rate; 
-   newrate = fp->rate[0][0][0]; 
+   //if (fp->Rate(0,0,0) <= 0) printf("ERROR: newrate <= 0 in update_tube_rates.\n");
 
-   //if (newrate <= 0) printf("ERROR: newrate <= 0 in update_tube_rates.\n");
+   /* sums are recomputed, not adjusted, so no numerical error accumulates */
+   tp->flake_rates[tp->flake_slots+fp->flake_index] = flake_rate(fp);
+   fix_flake_rates(tp,fp->flake_index);
 
-   while (ftp!=NULL) {
-      ftp->rate+=newrate-oldrate;
-      ftp=ftp->up;
+} // update_tube_rates()
+
+
+/* [validate] report one discrepancy: what a recount gives, and what was */
+/* kept.  only the first VALIDATE_LINES of a run are printed.            */
+#define VALIDATE_LINES 100
+#define Vdiff(a,b) (fabs((double)(a)-(double)(b)) > 1e-9*(fabs((double)(a))+fabs((double)(b))))
+
+static int validate_report(tube *tp, flake *fp, double is, double kept, const char *fmt, ...)
+{
+   va_list ap;
+   if (tp->validate_bad++ < VALIDATE_LINES) {
+      fprintf(stderr,"validate: event %llu: ",tp->events);
+      if (fp!=NULL) fprintf(stderr,"flake %d: ",fp->flake_ID);
+      va_start(ap,fmt);  vfprintf(stderr,fmt,ap);  va_end(ap);
+      fprintf(stderr," is %g, kept as %g (off by %g)\n",is,kept,kept-is);
+      if (tp->validate_bad==VALIDATE_LINES) 
+         fprintf(stderr,"validate: further discrepancies are only counted\n");
    }
-   // Make sure tree notes don't accumulate numerical error
-   ftp = fp->tree_node;
-   while (ftp!=NULL) {
-      if (ftp->fp == NULL) {
-         ftp->rate = ftp->left->rate + ftp->right->rate;
+   return 1;
+}
+
+/* recount one flake: the seed, its tiles, G (unless concentrations have */
+/* been depleted since tiles attached), the stats of check_flake_stats,  */
+/* every cell's rate and class, the pyramid sums, and tile_sites[].      */
+static int validate_flake(flake *fp, int check_G)
+{
+   tube *tp=fp->tube;  int size=(1<<fp->P), N=fp->N, B=fp->page_bits;
+   int i,j,k,l,n,t,id,i0,i1,j0,j1, bad=0, tiles=0, used=0, all_used=0;
+   int listed_off=0, listed_sites=0, len_off=0, len_sites=0;
+   double r, G=0, leaves=0, frozen=0;  unsigned long q, c, pages=1UL<<(2*(fp->P-B));
+   flake_page *pg;  int *sites = (int *)calloc_err(sizeof(int),N+1);
+
+   /* the seed, and the other half of a double-tile seed */
+   n = periodic ? fp->Cell((fp->seed_i+size)%size,(fp->seed_j+size)%size) : 
+      fp->Cell(fp->seed_i,fp->seed_j);
+   if (n != fp->seed_n) bad += validate_report(tp,fp,n,fp->seed_n,
+         "tile at the seed site %d,%d",fp->seed_i,fp->seed_j);
+   if (tp->dt_right[fp->seed_n] && fp->Cell(fp->seed_i,fp->seed_j+1) != tp->dt_right[fp->seed_n])
+      bad += validate_report(tp,fp,fp->Cell(fp->seed_i,fp->seed_j+1),tp->dt_right[fp->seed_n],
+            "right half of the seed");
+   if (tp->dt_left[fp->seed_n] && fp->Cell(fp->seed_i,fp->seed_j-1) != tp->dt_left[fp->seed_n])
+      bad += validate_report(tp,fp,fp->Cell(fp->seed_i,fp->seed_j-1),tp->dt_left[fp->seed_n],
+            "left half of the seed");
+   if (tp->dt_down[fp->seed_n] && fp->Cell(fp->seed_i+1,fp->seed_j) != tp->dt_down[fp->seed_n])
+      bad += validate_report(tp,fp,fp->Cell(fp->seed_i+1,fp->seed_j),tp->dt_down[fp->seed_n],
+            "bottom half of the seed");
+   if (tp->dt_up[fp->seed_n] && fp->Cell(fp->seed_i-1,fp->seed_j) != tp->dt_up[fp->seed_n])
+      bad += validate_report(tp,fp,fp->Cell(fp->seed_i-1,fp->seed_j),tp->dt_up[fp->seed_n],
+            "top half of the seed");
+   if (tp->tinybox && fp->tiles <= 1+(fp->seed_is_double_tile || fp->seed_is_vdouble_tile))
+      bad += validate_report(tp,fp,2+(fp->seed_is_double_tile || fp->seed_is_vdouble_tile),fp->tiles,
+            "# tiles of a tinybox flake, at least,");
+
+   /* every cell that can have an event: tiles and the empty sites by them */
+   flake_box(fp,1,&i0,&i1,&j0,&j1);
+   for (i=i0;i<=i1;i++) for (j=j0;j<=j1;j++) {
+      int x=(i<<fp->P)+j, cls=0, slot=0;  double leaf=0;  float fr=0;
+      if ((pg=cell_page(fp,x,&k))!=NULL) {
+         leaf = pg->rate[PageLevel(B)+k];
+         cls = pg->cell_class[k];  slot = pg->cell_slot[k];  used += (cls!=0);
+      }
+      fr = frozen_at(fp, Morton(i,j)>>(2*B), k);
+      leaves += leaf;  frozen += fr;
+      if ((n=fp->Cell(i,j))>0) {
+         tiles++;
+         if (tp->conc[n]<=fp->flake_conc) ;
+         else if (tp->dt_right[n]) G += -log(tp->conc[n]) - Gse_double(fp,i,j,n)/2.0 - tp->Gcb[n];
+         else if (tp->dt_down[n]) G += -log(tp->conc[n]) - Gse_vdouble(fp,i,j,n)/2.0 - tp->Gcb[n];
+         else if (!tp->dt_left[n] && !tp->dt_up[n]) G += -log(tp->conc[n]) - Gse(fp,i,j,n)/2.0 - tp->Gcb[n];
+      }
+      if (Frozen(fp,i,j)) { 
+         if (leaf!=0 || cls!=0) bad += validate_report(tp,fp,0,leaf+fr,
+               "rate of cell %d,%d, left behind by the window,",i,j);
+         continue;
+      }
+      if (n==0) {
+         id = site_signature(fp,i,j);
+         if (leaf!=0 || fr!=0) bad += validate_report(tp,fp,0,leaf+fr,"off-rate of empty cell %d,%d",i,j);
+         if (cls != (id>=0 ? -(id+1) : 0)) 
+            bad += validate_report(tp,fp,id,cls<0 ? -cls-1 : -1,"signature id of empty cell %d,%d",i,j);
+         if (id>=0) {
+            listed_sites += (slot>0);
+            for (t=0; t<tp->sigs[id].ntiles; t++) sites[tp->sigs[id].tiles[t]]++;
+         }
+      } else if (tp->off_lazy) {
+         double u = cell_units(fp,i,j,n);
+         r = calc_rates(fp,i,j,NULL);
+         if (leaf!=0) bad += validate_report(tp,fp,0,leaf,"pyramid rate of classed cell %d,%d",i,j);
+         if (cls<=0 || tp->off_units[cls-1]!=u) 
+            bad += validate_report(tp,fp,u,cls>0 ? tp->off_units[cls-1] : -1,
+                  "bond strength class of cell %d,%d",i,j);
+         if ((slot>0) != (r>0)) bad += validate_report(tp,fp,r>0,slot>0,"listing of cell %d,%d",i,j);
+         listed_off += (slot>0);
+      } else {
+         r = calc_rates(fp,i,j,NULL);
+         if (cls!=0) bad += validate_report(tp,fp,0,cls,"class of cell %d,%d",i,j);
+         if (fr!=0 && tp->freeze<=0) bad += validate_report(tp,fp,0,fr,"set-aside rate of cell %d,%d",i,j);
+         if (fr!=0 ? (leaf!=0 || fr!=(float)r) : Vdiff(r,leaf)) 
+            bad += validate_report(tp,fp,r,fr!=0 ? fr : leaf,"off-rate of cell %d,%d",i,j);
       }
-      ftp = ftp->up;
    }
 
-} // update_tube_rates()
+   /* the pyramid: each node the sum of its children, and nothing that */
+   /* the cells above didn't account for                               */
+   for (q=0; q<pages; q++) {
+      double sum=0;
+      if ((pg=fp->page[q])!=NULL) {
+         all_used += pg->used;
+         for (l=B-1; l>=1; l--) for (k=0; k < (1<<(2*l)); k++) {
+            c = PageLevel(l+1) + 4*k;
+            if (Vdiff(pg->rate[PageLevel(l)+k], pg->rate[c]+pg->rate[c+1]+pg->rate[c+2]+pg->rate[c+3]))
+               bad += validate_report(tp,fp,pg->rate[c]+pg->rate[c+1]+pg->rate[c+2]+pg->rate[c+3],
+                     pg->rate[PageLevel(l)+k],"rate sum %d,%d of page %lu",l,k,q);
+         }
+         for (k=0; k<PAGE_CELLS; k++) if (pg->rate[PageLevel(B)+k]<0) 
+            bad += validate_report(tp,fp,0,pg->rate[PageLevel(B)+k],"negative rate %d in page %lu",k,q);
+         sum = pg->rate[0]+pg->rate[1]+pg->rate[2]+pg->rate[3];
+      }
+      if (Vdiff(fp->rate[RateLevel(fp->P-B)+q], sum))
+         bad += validate_report(tp,fp,sum,fp->rate[RateLevel(fp->P-B)+q],"rate of page %lu",q);
+   }
+   for (l=fp->P-B-1; l>=0; l--) for (q=0; q < (1UL<<(2*l)); q++) {
+      c = RateLevel(l+1) + 4*q;
+      if (Vdiff(fp->rate[RateLevel(l)+q], fp->rate[c]+fp->rate[c+1]+fp->rate[c+2]+fp->rate[c+3]))
+         bad += validate_report(tp,fp,fp->rate[c]+fp->rate[c+1]+fp->rate[c+2]+fp->rate[c+3],
+               fp->rate[RateLevel(l)+q],"rate sum %d,%lu of the pyramid",l,q);
+   }
+   if (Vdiff(leaves, fp->Rate(0,0,0))) 
+      bad += validate_report(tp,fp,leaves,fp->Rate(0,0,0),"off-rate of the cells by the flake");
+   if (used != all_used) bad += validate_report(tp,fp,used,all_used,"# classed cells");
+   if (Vdiff(frozen, fp->frozen_rate)) bad += validate_report(tp,fp,frozen,fp->frozen_rate,"set-aside rate");
+
+   /* the classes, and what the tube keeps for them */
+   for (id=0; id<fp->sites_n; id++) len_sites += fp->sites[id].len;
+   for (t=0; t<fp->off_n; t++) len_off += fp->off[t].len;
+   if (listed_sites != len_sites) bad += validate_report(tp,fp,listed_sites,len_sites,"# listed empty sites");
+   if (listed_off != len_off) bad += validate_report(tp,fp,listed_off,len_off,"# listed off-rate cells");
+   for (n=1; n<=N; n++) if (sites[n] != fp->tile_sites[n]) 
+      bad += validate_report(tp,fp,sites[n],fp->tile_sites[n],"# sites for tile %d",n);
+   if (fp->flake_index>=0 && Vdiff(flake_rate(fp), tp->flake_rates[tp->flake_slots+fp->flake_index]))
+      bad += validate_report(tp,fp,flake_rate(fp),tp->flake_rates[tp->flake_slots+fp->flake_index],
+            "off-rate in the flake sum tree");
+
+   if (tiles != fp->tiles) bad += validate_report(tp,fp,tiles,fp->tiles,"# tiles");
+   if (check_G && fabs(G - fp->G) > 1e-6*(1+fabs(G))) bad += validate_report(tp,fp,G,fp->G,"G");
+   k = check_flake_stats(fp);  bad += k;  tp->validate_bad += k;
+
+   free(sites);
+   return bad;
+} // validate_flake()
+
+/* recount, from scratch, what simulate() keeps up incrementally -- each */
+/* flake as above, the registry, the flake and tile-site sum trees, and  */
+/* the concentrations -- and report each discrepancy, with its size, on  */
+/* stderr.  returns the number found; nothing is changed.                */
+int validate_tube(tube *tp)
+{
+   int k, n, bad=0, flakes=0, check_G=1, slots=tp->flake_slots;  flake *fp;  double sum=0;
+
+   /* G is kept as of when each tile attached */
+   for (fp=tp->flake_list; fp!=NULL; fp=fp->next_flake) if (fp->flake_conc>0) check_G=0;
+
+   for (fp=tp->flake_list; fp!=NULL; fp=fp->next_flake) {
+      flakes++;
+      if (fp->flake_index<0 || fp->flake_index>=slots || tp->flakes[fp->flake_index]!=fp) 
+         bad += validate_report(tp,fp,-1,fp->flake_index,"registry slot");
+      else bad += validate_flake(fp,check_G);
+   }
+   if (flakes != tp->num_flakes) bad += validate_report(tp,NULL,flakes,tp->num_flakes,"# flakes");
+
+   for (k=1; k<slots; k++) 
+      if (Vdiff(tp->flake_rates[k], tp->flake_rates[2*k]+tp->flake_rates[2*k+1]))
+         bad += validate_report(tp,NULL,tp->flake_rates[2*k]+tp->flake_rates[2*k+1],tp->flake_rates[k],
+               "flake rate sum %d",k);
+   for (k=tp->num_flakes; k<slots; k++) if (tp->flake_rates[slots+k]!=0) 
+      bad += validate_report(tp,NULL,0,tp->flake_rates[slots+k],"rate of empty flake slot %d",k);
+   for (n=1; n<=tp->N; n++) {
+      tile_flakes *tf = &tp->tile_fl[n];  int *h = tf->sites, m = 0;
+      for (k=1; k<tf->cap; k++) if (h[k] != h[2*k]+h[2*k+1])
+         bad += validate_report(tp,NULL,h[2*k]+h[2*k+1],h[k],"# sites for tile %d, sum %d",n,k);
+      for (k=0; k<tf->cap; k++) {
+         fp = (k<tf->len && tf->slot[k]>=0 && tf->slot[k]<tp->num_flakes) ? tp->flakes[tf->slot[k]] : NULL;
+         if (k<tf->len && (fp==NULL || fp->tile_at[n]!=k+1 || fp->tile_sites[n]==0))
+            bad += validate_report(tp,NULL,-1,tf->slot[k],"flake slot in place %d for tile %d",k,n);
+         if (h[tf->cap+k] != (fp ? fp->tile_sites[n] : 0))
+            bad += validate_report(tp,NULL,fp ? fp->tile_sites[n] : 0,h[tf->cap+k],
+                  "# sites for tile %d in place %d",n,k);
+      }
+      for (k=0; k<tp->num_flakes; k++) if (tp->flakes[k]->tile_sites[n]) m++;
+      if (m != tf->len) bad += validate_report(tp,NULL,m,tf->len,"# flakes with sites for tile %d",n);
+   }
+
+   /* the on-rate and concentration trees: as computed from the leaves */
+   for (n=0; n<tp->on_slots; n++) {
+      int sites = (n>=1 && n<=tp->N) ? tp->tile_fl[n].sites[1] : 0;
+      double c = (n>=1 && n<=tp->N) ? tp->conc[n] : 0;
+      if (tp->on_tree[tp->on_slots+n] != ((sites && c>0) ? c*sites : 0))
+         bad += validate_report(tp,NULL,(sites && c>0) ? c*sites : 0,tp->on_tree[tp->on_slots+n],
+               "on-rate/k of tile %d",n);
+      if (tp->conc_tree[tp->on_slots+n] != MAX(0,c))
+         bad += validate_report(tp,NULL,MAX(0,c),tp->conc_tree[tp->on_slots+n],
+               "concentration tree leaf of tile %d",n);
+   }
+   for (k=1; k<tp->on_slots; k++) {
+      if (tp->on_tree[k] != tp->on_tree[2*k]+tp->on_tree[2*k+1])
+         bad += validate_report(tp,NULL,tp->on_tree[2*k]+tp->on_tree[2*k+1],tp->on_tree[k],
+               "on-rate/k sum %d",k);
+      if (tp->conc_tree[k] != tp->conc_tree[2*k]+tp->conc_tree[2*k+1])
+         bad += validate_report(tp,NULL,tp->conc_tree[2*k]+tp->conc_tree[2*k+1],tp->conc_tree[k],
+               "concentration sum %d",k);
+   }
+
+   /* concentrations [doubletile] */
+   for (n=1; n<=tp->N; n++) {
+      if (tp->conc[n]<0) bad += validate_report(tp,NULL,0,tp->conc[n],"concentration of tile %d, at least,",n);
+      if (tp->dt_right[n] && tp->conc[n]!=tp->conc[tp->dt_right[n]])
+         bad += validate_report(tp,NULL,tp->conc[n],tp->conc[tp->dt_right[n]],
+               "concentration of %d, the right half of %d,",tp->dt_right[n],n);
+      if (tp->dt_down[n] && tp->conc[n]!=tp->conc[tp->dt_down[n]])
+         bad += validate_report(tp,NULL,tp->conc[n],tp->conc[tp->dt_down[n]],
+               "concentration of %d, the bottom half of %d,",tp->dt_down[n],n);
+      sum += tp->conc[n];
+   }
+   if (fabs(sum - tp->conc[0]) > 1e-6*sum) 
+      bad += validate_report(tp,NULL,sum,tp->conc[0],"total concentration");
+
+   tp->validate_runs++;
+   tp->validate_next = tp->events + tp->validate;
+   return bad;
+} // validate_tube()
 
 
 int between_double_tile (flake *fp, tube *tp, int i, int j, Trep n) {
@@ -897,15 +1989,75 @@ int between_vdouble_tile (flake *fp, tube *tp, int i, int j, Trep n) {
 /* but since it might be called out of range in FILL, we fix it up.   */
 /* BUG: changes in concentration should change G for every tile, but  */
 /* we don't update G automatically; also, if conc[n]==0, nan results. */
-void change_cell(flake *fp, int i, int j, Trep n)
+/* bounding box upkeep: a row or column enters the box with its first  */
+/* tile, and when one empties at the box edge, the edge moves inward    */
+/* past every empty row or column, so the cost is paid back by growth.  */
+static void box_add(flake *fp, int i, int j)
 {
-   int size=(1<<fp->P);  tube *tp=fp->tube; 
+   if (fp->row_tiles[i]++==0) {
+      if (i<fp->box_i0) fp->box_i0=i;
+      if (i>fp->box_i1) fp->box_i1=i;
+   }
+   if (fp->col_tiles[j]++==0) {
+      if (j<fp->box_j0) fp->box_j0=j;
+      if (j>fp->box_j1) fp->box_j1=j;
+   }
+}
+
+static void box_remove(flake *fp, int i, int j)
+{
+   if (--fp->row_tiles[i]==0) {
+      while (fp->box_i0<=fp->box_i1 && fp->row_tiles[fp->box_i0]==0) fp->box_i0++;
+      while (fp->box_i1>=fp->box_i0 && fp->row_tiles[fp->box_i1]==0) fp->box_i1--;
+   }
+   if (--fp->col_tiles[j]==0) {
+      while (fp->box_j0<=fp->box_j1 && fp->col_tiles[fp->box_j0]==0) fp->box_j0++;
+      while (fp->box_j1>=fp->box_j0 && fp->col_tiles[fp->box_j1]==0) fp->box_j1--;
+   }
+}
+
+/* the region that whole-field scans need to visit: the bounding box     */
+/* widened by 'margin' cells (1 to reach empty sites next to the flake), */
+/* clipped to the field.  with periodic boundaries a widened box that    */
+/* crosses an edge wraps around, so that dimension is taken in full.     */
+/* for a flake with no tiles, *i0 > *i1 and *j0 > *j1.                   */
+void flake_box(flake *fp, int margin, int *i0, int *i1, int *j0, int *j1)
+{
+   int size=(1<<fp->P);
+   if (fp->box_i0>fp->box_i1) { *i0=*j0=0; *i1=*j1=-1; return; }
+   *i0=fp->box_i0-margin; *i1=fp->box_i1+margin;
+   *j0=fp->box_j0-margin; *j1=fp->box_j1+margin;
+   if (periodic && (*i0<0 || *i1>=size)) { *i0=0; *i1=size-1; }
+   if (periodic && (*j0<0 || *j1>=size)) { *j0=0; *j1=size-1; }
+   *i0=MAX(*i0,0); *i1=MIN(*i1,size-1);
+   *j0=MAX(*j0,0); *j1=MIN(*j1,size-1);
+} // flake_box()
+
+/* bond energy gained when tile n joins the flake at empty cell i,j;   */
+/* the second half of a double tile only adds the bonds that are new.  */
+static double cell_bonds(flake *fp, tube *tp, int i, int j, Trep n)
+{
+   if (tp->dt_right[n]) return Gse_double_left(fp,i,j,n);
+   else if (tp->dt_left[n]) return Gse_double_right(fp,i,j,n);
+   else if (tp->dt_down[n]) return Gse_vdouble_up(fp,i,j,n);
+   else if (tp->dt_up[n]) return Gse_vdouble_down(fp,i,j,n);
+   else return Gse(fp,i,j,n);
+}
+
+/* G, dG_bonds, perimeter and mismatches are kept up to date here, so */
+/* that recalc_G(), calc_dG_bonds() and calc_perimeter() are needed   */
+/* only after parameter changes, or to check them.                    */
+KERNEL void change_cell_k(flake *fp, int i, int j, Trep n, const int plain)
+{
+   int size=(1<<fp->P), occ;  tube *tp=fp->tube;  Trep old;  double gb, gold;
    dprintf("Entering change cell to change flake %d, cell %d,%d from %d to %d.\n",fp->flake_ID,i,j,fp->Cell(i,j),n);
-   if (periodic) { i=(i+size)%size; j=(j+size)%size; }
+   if (!plain && periodic) { i=(i+size)%size; j=(j+size)%size; }
    else if (i<0 || i>=size || j<0 || j>=size) return; // can't change tiles beyond central field
-   if (fp->Cell(i,j)==n) return;
+   if ((old=fp->Cell(i,j))==n) return;
    if (tp!=NULL) { /* flake has been added to a tube */
-      if (fp->Cell(i,j)==0) {                         /* tile addition */
+      if (old==0) {                                   /* tile addition */
+         gb = plain ? Gse(fp,i,j,n) : cell_bonds(fp,tp,i,j,n);
+         fp->dG_bonds -= gb + ((!plain && (tp->dt_left[n] || tp->dt_up[n])) ? 0 : tp->Gcb[n]);
          if (tp->conc[n]<=fp->flake_conc) {
             dprintf ("Zero concentration in tile addition, tile %d at %d, %d.\n", n, i, j);
          }
@@ -913,41 +2065,36 @@ void change_cell(flake *fp, int i, int j, Trep n)
             dprintf ("Zero concentration of seed (tile %d)!\n", fp->seed_n);
          }
          //      printf("Changing flake %d, cell %d,%d from %d to %d.\n",fp->flake_ID,i,j,fp->Cell(i,j),n);
-         else if (tp->dt_right[n]) fp->G += -log(tp->conc[n]) - Gse_double_left(fp,i,j,n);
-         else if (tp->dt_left[n]) fp->G += - Gse_double_right(fp,i,j,n);
-         else if (tp->dt_down[n]) fp->G += -log(tp->conc[n]) - Gse_vdouble_up(fp,i,j,n);
-         else if (tp->dt_up[n]) fp->G += - Gse_vdouble_down(fp,i,j,n);
-         else fp->G += -log(tp->conc[n]) - Gse(fp,i,j,n);
+         else if (!plain && (tp->dt_left[n] || tp->dt_up[n])) fp->G += - gb;
+         else fp->G += -log(tp->conc[n]) - gb;
 
          // Don't subtract [] if we're adding the other half of a dt seed:
-         if ((!fp->seed_is_double_tile && !fp->seed_is_vdouble_tile) || fp->tiles > 1) {
-            tp->conc[n] -= fp->flake_conc; 
-            tp->conc[0] -= fp->flake_conc;
+         if (plain || (!fp->seed_is_double_tile && !fp->seed_is_vdouble_tile) || fp->tiles > 1) {
+            add_conc(tp, n, -fp->flake_conc);
          }
-         if ((fp->tiles==1 && (!fp->seed_is_double_tile && !fp->seed_is_vdouble_tile)) || (fp->tiles==2 && 
+         if (plain ? fp->tiles==1 : 
+               (fp->tiles==1 && (!fp->seed_is_double_tile && !fp->seed_is_vdouble_tile)) || (fp->tiles==2 && 
                      (fp->seed_is_double_tile || fp->seed_is_vdouble_tile))) { 
             // monomer flakes don't deplete []; now no longer monomer!
-            tp->conc[fp->seed_n] -= fp->flake_conc; 
-            tp->conc[0]          -= fp->flake_conc;
-            if (tp->dt_right[fp->seed_n]) {
-               tp->conc[tp->dt_right[fp->seed_n]] -= fp->flake_conc;
-               tp->conc[0]          -= fp->flake_conc;
-            }
-            if (tp->dt_left[fp->seed_n]) {
-               tp->conc[tp->dt_left[fp->seed_n]] -= fp->flake_conc;
-               tp->conc[0]          -= fp->flake_conc;
-            }
-            if (tp->dt_down[fp->seed_n]) {
-               tp->conc[tp->dt_down[fp->seed_n]] -= fp->flake_conc;
-               tp->conc[0]          -= fp->flake_conc;
-            }
-            if (tp->dt_up[fp->seed_n]) {
-               tp->conc[tp->dt_up[fp->seed_n]] -= fp->flake_conc;
-               tp->conc[0]          -= fp->flake_conc;
+            add_conc(tp, fp->seed_n, -fp->flake_conc);
+            if (!plain) {
+               if (tp->dt_right[fp->seed_n]) {
+                  add_conc(tp, tp->dt_right[fp->seed_n], -fp->flake_conc);
+               }
+               if (tp->dt_left[fp->seed_n]) {
+                  add_conc(tp, tp->dt_left[fp->seed_n], -fp->flake_conc);
+               }
+               if (tp->dt_down[fp->seed_n]) {
+                  add_conc(tp, tp->dt_down[fp->seed_n], -fp->flake_conc);
+               }
+               if (tp->dt_up[fp->seed_n]) {
+                  add_conc(tp, tp->dt_up[fp->seed_n], -fp->flake_conc);
+               }
             }
 
          }
          tp->stat_a++; fp->tiles++; 
+         if (fp->tiles == tp->big_size) tp->big_flakes++;
          if (fp->tiles > tp->largest_flake_size) {
             tp->largest_flake = fp->flake_ID;
             tp->largest_flake_size = fp->tiles;
@@ -956,53 +2103,51 @@ void change_cell(flake *fp, int i, int j, Trep n)
          tp->stat_m += Mism(fp,i,j,n);
       } 
       else if (n==0) {                              /* tile loss */
-         tp->conc[0] += fp->flake_conc; 
-         tp->conc[fp->Cell(i,j)] += fp->flake_conc; 
-         if (tp->dt_right[fp->Cell(i,j)]) fp->G += +log(tp->conc[fp->Cell(i,j)]) + Gse_double_left(fp,i,j,fp->Cell(i,j));
-         else if (tp->dt_left[fp->Cell(i,j)]) fp->G += + Gse_double_right(fp,i,j,fp->Cell(i,j));
-         else if (tp->dt_down[fp->Cell(i,j)]) fp->G += +log(tp->conc[fp->Cell(i,j)]) + Gse_vdouble_up(fp,i,j,fp->Cell(i,j));
-         else if (tp->dt_up[fp->Cell(i,j)]) fp->G += + Gse_vdouble_down(fp,i,j,fp->Cell(i,j));
-         else fp->G += +log(tp->conc[fp->Cell(i,j)]) + Gse(fp,i,j,fp->Cell(i,j));
+         add_conc(tp, old, fp->flake_conc);
+         gb = plain ? Gse(fp,i,j,old) : cell_bonds(fp,tp,i,j,old);
+         fp->dG_bonds += gb + ((!plain && (tp->dt_left[old] || tp->dt_up[old])) ? 0 : tp->Gcb[old]);
+         if (!plain && (tp->dt_left[old] || tp->dt_up[old])) fp->G += + gb;
+         else fp->G += +log(tp->conc[old]) + gb;
          //fp->G += log(tp->conc[fp->Cell(i,j)]) + Gse(fp,i,j,fp->Cell(i,j));
 
          // monomer flakes don't deplete []; just became monomer!
          // zzz check this
          //if (fp->tiles==2 || (fp->tiles==3 && tp->dt_right[fp->Cell(i,j)])) { 
-         if (fp->tiles==2 || (fp->tiles==3 && (fp->seed_is_double_tile || fp->seed_is_vdouble_tile))) { 
-            tp->conc[fp->seed_n] += fp->flake_conc; 
-            tp->conc[0]          += fp->flake_conc;
-            if (tp->dt_right[fp->seed_n]) {
-               tp->conc[tp->dt_right[fp->seed_n]] += fp->flake_conc;
-               tp->conc[0]          += fp->flake_conc;
-            }
-            if (tp->dt_left[fp->seed_n]) {
-               tp->conc[tp->dt_left[fp->seed_n]] += fp->flake_conc;
-               tp->conc[0]          += fp->flake_conc;
-            }
-            if (tp->dt_down[fp->seed_n]) {
-               tp->conc[tp->dt_down[fp->seed_n]] += fp->flake_conc;
-               tp->conc[0]          += fp->flake_conc;
-            }
-            if (tp->dt_up[fp->seed_n]) {
-               tp->conc[tp->dt_up[fp->seed_n]] += fp->flake_conc;
-               tp->conc[0]          += fp->flake_conc;
+         if (fp->tiles==2 || (!plain && fp->tiles==3 && (fp->seed_is_double_tile || fp->seed_is_vdouble_tile))) { 
+            add_conc(tp, fp->seed_n, fp->flake_conc);
+            if (!plain) {
+               if (tp->dt_right[fp->seed_n]) {
+                  add_conc(tp, tp->dt_right[fp->seed_n], fp->flake_conc);
+               }
+               if (tp->dt_left[fp->seed_n]) {
+                  add_conc(tp, tp->dt_left[fp->seed_n], fp->flake_conc);
+               }
+               if (tp->dt_down[fp->seed_n]) {
+                  add_conc(tp, tp->dt_down[fp->seed_n], fp->flake_conc);
+               }
+               if (tp->dt_up[fp->seed_n]) {
+                  add_conc(tp, tp->dt_up[fp->seed_n], fp->flake_conc);
+               }
             }
          }
          tp->stat_d++; fp->tiles--; 
+         if (fp->tiles == tp->big_size-1) tp->big_flakes--;
          fp->mismatches -= Mism(fp,i,j,fp->Cell(i,j));
          tp->stat_m -= Mism(fp,i,j,fp->Cell(i,j));
       } 
       else {                               /* tile hydrolysis or replacement */
-         fp->G += Gse(fp,i,j,fp->Cell(i,j)) - Gse(fp,i,j,n) +
-            log(tp->conc[fp->Cell(i,j)]) - log(tp->conc[n]) + 
-            tp->Gcb[fp->Cell(i,j)] - tp->Gcb[n]; 
+         gold = Gse(fp,i,j,old);  gb = Gse(fp,i,j,n);
+         fp->G += gold - gb +
+            log(tp->conc[old]) - log(tp->conc[n]) + 
+            tp->Gcb[old] - tp->Gcb[n]; 
+         fp->dG_bonds += gold - gb + tp->Gcb[old] - tp->Gcb[n];
          tp->stat_h++; 
          /* by our rules, hydrolyzed tiles have same se types as non-hyd. */
       }
       tp->events++; fp->events++;
    }
 
-   if (tp && present_list_len) {
+   if (!plain && tp && present_list_len) {
       int z,y,not_all_yet;
       if (n) {
          not_all_yet = 0;
@@ -1050,13 +2195,24 @@ void change_cell(flake *fp, int i, int j, Trep n)
       }
    }
 
+   /* each tile edge facing an empty cell is one unit of perimeter */
+   occ = (fp->Cell(i-1,j)!=0) + (fp->Cell(i+1,j)!=0) + 
+      (fp->Cell(i,j-1)!=0) + (fp->Cell(i,j+1)!=0);
+   if (old==0) { box_add(fp,i,j); fp->perimeter += 4-2*occ; }
+   else if (n==0) { box_remove(fp,i,j); fp->perimeter -= 4-2*occ; }
+   row_touch(fp,i+1);
    fp->Cell(i,j)=n; 
-   if (periodic) { int size=(1<<fp->P);
-      if (i==0)      fp->Cell(size,j)=n;
-      if (i==size-1) fp->Cell(-1,j)=n;
+   if (!plain && periodic) { int size=(1<<fp->P);
+      if (i==0)      { row_touch(fp,size+1);  fp->Cell(size,j)=n; }
+      if (i==size-1) { row_touch(fp,0);  fp->Cell(-1,j)=n; }
       if (j==0)      fp->Cell(i,size)=n;
       if (j==size-1) fp->Cell(i,-1)=n;
    }
+   if (n==0 && fp->row_tiles[i]==0) {   /* (with its periodic copy) */
+      row_drop(fp,i+1);
+      if (!plain && periodic && i==0)      row_drop(fp,size+1);
+      if (!plain && periodic && i==size-1) row_drop(fp,0);
+   }
 
    // If we've changed to a state we haven't seen before, and we're counting
    // unique visited states, record it.
@@ -1080,29 +2236,54 @@ void change_cell(flake *fp, int i, int j, Trep n)
 #endif
       }
    }
+   /* [atam] the frontier engine keeps no rates */
+   if (!plain && tp!=NULL && tp->atam) return;
    // note: this recalculates all these rates from scratch, although we know only some can change
-   update_rates(fp,i,j);
-   update_rates(fp,i+1,j);
-   update_rates(fp,i-1,j);
-   update_rates(fp,i,j+1);
-   update_rates(fp,i,j-1);
-   // Also change these in case of double tiles or chunk_fission
-   // TODO : just check if we have double tiles or chunk fission before
-   // doing these tedious updates
-   // FIXME: these are disabled because tiles being added/removed singly
-   // should mean they don't matter. FIXME FIXME FIXME
-   update_rates(fp,i-1,j+1);
-   update_rates(fp,i+1,j+1);
-   update_rates(fp,i-1,j-1);
-   update_rates(fp,i+1,j-1);
-   update_rates(fp,i,j+2);
-   update_rates(fp,i-1,j+2);
-   update_rates(fp,i+1,j+2);
-   update_rates(fp,i,j-2);
-   update_rates(fp,i-1,j-2);
-   update_rates(fp,i+1,j-2);
+   if (plain) {  /* single tiles, no chunks: only the site and its neighbours */
+      update_rates_plain(fp,i,j);
+      update_rates_plain(fp,i+1,j);
+      update_rates_plain(fp,i-1,j);
+      update_rates_plain(fp,i,j+1);
+      update_rates_plain(fp,i,j-1);
+   } else {
+      update_rates(fp,i,j);
+      update_rates(fp,i+1,j);
+      update_rates(fp,i-1,j);
+      update_rates(fp,i,j+1);
+      update_rates(fp,i,j-1);
+      // Also change these in case of double tiles or chunk_fission
+      // FIXME: these are disabled because tiles being added/removed singly
+      // should mean they don't matter. FIXME FIXME FIXME
+      update_rates(fp,i-1,j+1);
+      update_rates(fp,i+1,j+1);
+      update_rates(fp,i-1,j-1);
+      update_rates(fp,i+1,j-1);
+      update_rates(fp,i,j+2);
+      update_rates(fp,i-1,j+2);
+      update_rates(fp,i+1,j+2);
+      update_rates(fp,i,j-2);
+      update_rates(fp,i-1,j-2);
+      update_rates(fp,i+1,j-2);
+      // and the same reach up and down, for vdouble tiles
+      update_rates(fp,i+2,j);
+      update_rates(fp,i+2,j-1);
+      update_rates(fp,i+2,j+1);
+      update_rates(fp,i-2,j);
+      update_rates(fp,i-2,j-1);
+      update_rates(fp,i-2,j+1);
+   }
    if (tp!=NULL) update_tube_rates(fp);
-} // change_cell()
+} // change_cell_k()
+
+void change_cell(flake *fp, int i, int j, Trep n)
+{
+   change_cell_k(fp,i,j,n,0);
+}
+
+static void change_cell_plain(flake *fp, int i, int j, Trep n)
+{
+   change_cell_k(fp,i,j,n,1);
+}
 
 void change_seed(flake *fp, int new_i, int new_j)
 {  int old_i=fp->seed_i; int old_j=fp->seed_j;
@@ -1153,110 +2334,151 @@ void change_seed(flake *fp, int new_i, int new_j)
 } // change_seed()
 
 
+/* choose index c in 0...n-1 with probability w[c]/sum w[], using the  */
+/* uniform *r in [0,1).  the comparisons use the same left-to-right     */
+/* partial sums that make up the total, and anything rounding past the  */
+/* end lands on the last non-zero weight, so the choice never fails and */
+/* never needs a retry.  on return, *r has been rescaled to a uniform  */
+/* within w[c] for use at the next level; *res tracks how much of the   */
+/* original resolution is left, and fresh bits are drawn once fewer     */
+/* than about 20 of its 53 remain.  if sum w[] isn't > 0 there's        */
+/* nothing to choose: the last index is returned with fresh bits, so a  */
+/* caller that didn't check gets an index in range rather than a NaN.   */
+#define FRESH_BITS_BELOW (1.0/4294967296.0)
+static int pick_weight(const double *w, int n, double *r, double *res, xgrow_rng *rng)
+{
+   double sum=0, x, below=0;
+   int c, last=0;
+
+   for (c=0; c<n; c++) { sum += w[c]; if (w[c]>0) last=c; }
+   if (!(sum>0)) { *r = rng_uniform(rng); *res = 1; return n-1; }
+   x = (*r)*sum;
+   for (c=0; c<last; c++) {
+      if (w[c]>0 && x < below+w[c]) break;
+      below += w[c];
+   }
+   *r = (x-below)/w[c];
+   if (*r < 0) *r = 0; else if (*r >= 1) *r = 1-DBL_EPSILON/2;
+   *res *= w[c]/sum;
+   if (*res < FRESH_BITS_BELOW) { *r = rng_uniform(rng); *res = 1; }
+   return c;
+}
+
+/* choose a tile type in proportion to its concentration, down the    */
+/* concentration tree.  conc[0] is only maintained incrementally, so   */
+/* it is set to the tree's exact sum here as well.                     */
 int choose_tile_type (tube *tp) {
-   double r, cum;
-   int oops, n;
-   // This is exactly the same code as inside choose_cell,
-   // but because that code is used so often, and this will be used for
-   // adding a flake, which we imagine doing much less often, the
-   // other code was left inline.
-   r = drand48();
-   do {
-      r = r * tp->conc[0];  cum = 0;  oops=0;
-      for (n=1; n<=tp->N; n++) if (r < (cum += tp->conc[n])) break; 
-      if (n>tp->N) { // apparently conc[0] is not the sum of conc[n], oops
-         printf("Concentration sum error!!! %f =!= %f\n",tp->conc[0],cum); 
-         r=drand48(); oops=1; 
-         tp->conc[0]=0; for (n=1; n <= tp->N; n++) tp->conc[0]+=tp->conc[n];
-      }
-   } while (oops);
-   return n;
+   double r, res=1;
+   int k=1;
+
+   tp->conc[0] = tp->conc_tree[1];
+   r = rng_uniform(&tp->rng);
+   while (k < tp->on_slots) 
+      k = 2*k + pick_weight(&tp->conc_tree[2*k], 2, &r, &res, &tp->rng);
+   return k - tp->on_slots;
+}
+
+/* the tube's total on-event rate, k sum over n of conc[n] times the   */
+/* number of sites (in all flakes) where tile n could attach: the root */
+/* of the on-rate tree, whose leaves change only with conc[n] or with  */
+/* n's count of sites (see fix_on_rate).                               */
+double tube_on_rate(tube *tp)
+{
+   return tp->k*tp->on_tree[1];
 }
 
-/* use rates & empty & conc to choose a cell to change,      */
+/* choose an on-event in proportion to the on-rate tree: a tile type   */
+/* n, then uniformly one of the sites where n could attach, using the  */
+/* sum tree over n's list of flakes to find its flake.                 */
+/* report choice, but don't act on it.                                 */
+flake *choose_on_event(tube *tp, int *ip, int *jp, int *np)
+{
+   double r, res=1;
+   int n, k, s, id=0, x, *h;  long u;  flake *fp;  tile_flakes *tf;
+
+   r = rng_uniform(&tp->rng);  // re-used, rescaled, for all levels
+   for (k=1; k < tp->on_slots; ) 
+      k = 2*k + pick_weight(&tp->on_tree[2*k], 2, &r, &res, &tp->rng);
+   n = k - tp->on_slots;
+   tf = &tp->tile_fl[n];  h = tf->sites;
+   u = MIN((long)(r*h[1]), h[1]-1);   /* which of n's h[1] sites */
+   for (k=1; k<tf->cap; ) {
+      if (u < h[2*k]) k = 2*k; else { u -= h[2*k]; k = 2*k+1; }
+   }
+   fp = tp->flakes[tf->slot[k-tf->cap]];
+   for (s=0; s<tp->num_sigs_with[n]; s++) {
+      id = tp->sigs_with[n][s];
+      if (id < fp->sites_n) {
+         if (u < fp->sites[id].len) break;
+         u -= fp->sites[id].len;
+      }
+   }
+   assert(s < tp->num_sigs_with[n]);
+   x = fp->sites[id].cells[u];
+   *ip = x >> fp->P;  *jp = x & ((1<<fp->P)-1);  *np = n;
+   return fp;
+} // choose_on_event()
+
+/* use rates to choose an occupied cell to change,           */
 /* and call calc_rates to identify what change to make.      */
 /* report choice, but don't act on it.                       */
 void choose_cell(flake *fp, int *ip, int *jp, int *np)
 {
-   double sum,cum,r,k00,k01,k10,k11;
-   int p,i,j,di=1,dj=1,n,oops;   tube *tp=fp->tube;
-
-
-   sum = fp->rate[0][0][0];
-
-   i=0; j=0;  r=drand48();  // we'll re-use this random number for all levels
+   double r, res=1, sum;
+   int p,i,j,c,n;   tube *tp=fp->tube;
+   unsigned long m=0, k=0;  flake_page *pg=NULL;
+
+
+   i=0; j=0;  r=rng_uniform(&tp->rng);  // re-used, rescaled, for all levels
+   if (fp->off_n > 0) {   /* the pyramid, or one of the off-rate classes? */
+      tp->off_w[0] = fp->Rate(0,0,0);
+      for (c=0; c<fp->off_n; c++) tp->off_w[1+c] = fp->off[c].len * tp->off_rate[c];
+      c = pick_weight(tp->off_w, 1+fp->off_n, &r, &res, &tp->rng);
+      if (c > 0) {        /* all cells of a class are equally likely */
+         cell_list *oc = &fp->off[c-1];
+         int x = MIN((int)(r*oc->len), oc->len-1);
+         x = oc->cells[x];
+         *ip = x >> fp->P;  *jp = x & ((1<<fp->P)-1);  *np = 0;
+         return;
+      }
+   }
    for (p=0; p<fp->P; p++) { /* choosing subquadrant from within p:i,j */
-      k00 = fp->rate[p+1][2*i][2*j];
-      k10 = fp->rate[p+1][2*i+1][2*j];
-      k01 = fp->rate[p+1][2*i][2*j+1];
-      k11 = fp->rate[p+1][2*i+1][2*j+1];
-      sum = (k00+k01+k10+k11);  
-      /* avoid possible round-off error... but still check for it */
-      d2printf("%f / %f for choosing %d from %d: %d %d\n",r,sum,p+1,p,i,j);
-      do {
-         r = r*sum;  oops=0;
-         if ( (r-=k00) < 0) { di=0; dj=0; r=(r+k00)/k00; } else
-            if ( (r-=k10) < 0) { di=1; dj=0; r=(r+k10)/k10; } else
-               if ( (r-=k01) < 0) { di=0; dj=1; r=(r+k01)/k01; } else
-                  if ( (r-=k11) < 0) { di=1; dj=1; r=(r+k11)/k11; } else 
-                  { printf("Cell choice rand error!\n"); r=drand48(); oops=1; }
-      } while (oops); 
-      i=2*i+di; j=2*j+dj;
+      /* the four children are adjacent, in order 00 01 10 11 */
+      d2printf("%f for choosing %d from %d: %d %d\n",r,p+1,p,i,j);
+      if (p < fp->P-fp->page_bits)
+         c = pick_weight(&fp->rate[RateLevel(p+1)+4*m], 4, &r, &res, &tp->rng);
+      else {   /* a node with rate > 0 always has its page */
+         if (p == fp->P-fp->page_bits) { pg = fp->page[m]; k = 0; }
+         c = pick_weight(&pg->rate[PageLevel(p+1-(fp->P-fp->page_bits))+4*k], 4, 
+               &r, &res, &tp->rng);
+         k = 4*k+c;
+      }
+      i=2*i+(c>>1); j=2*j+(c&1); m=4*m+c;
    }
    *ip=i; *jp=j;
-   // upon exit, we should still have a good random number r
-
-   if (fp->Cell(i,j) == 0) {   /* choose on-event for type 1...N            */
-      do {
-         r = r * fp->rate[fp->P][i][j];  cum = 0;  oops=0;
-         for (n=1; n<=fp->N; n++) {
-            if (Gse(fp,i,j,n)==0) continue;
-            if (tp->T>0 && Gse(fp,i,j,n)<tp->T) continue;
-            if (r < (cum += tp->k*tp->conc[n])) break;
-         }
-         if (n>fp->N) { // apparently conc[0] is not the sum of conc[n], oops
-            printf("Concentration sum error!!! %f =!= %f\n",tp->conc[0],cum); 
-            r=drand48(); oops=1; 
-            tp->conc[0]=0; for (n=1; n <= tp->N; n++) tp->conc[0]+=tp->conc[n];
-         }
-      } while (oops);
-   } else {                    /* choose off-event 0 or conversion to 1...N */
-      if (tp->hydro) {
-         sum = calc_rates(fp,i,j,tp->rv);
-         if (sum==0) printf("Zero-sum hydro rate was chosen!!!\n");
-         r = r * sum;  cum = 0;
-         for (n=0; n<=fp->N; n++) if (r < (cum += tp->rv[n])) break; 
-         if (n>fp->N) { printf("Hydro failed to choose anyone!!!\n"); n=0; }
-      } else {
-         n=0;  // always an off-event, unless hydrolysis rules are used.
-      }
+   // upon exit, we still have a good random number r
+
+   /* choose off-event 0 or conversion to 1...N */
+   if (tp->hydro) {
+      sum = calc_rates(fp,i,j,tp->rv);
+      if (sum==0) { printf("Zero-sum hydro rate was chosen!!!\n"); n=0; }
+      else n = pick_weight(tp->rv, fp->N+1, &r, &res, &tp->rng);
+   } else {
+      n=0;  // always an off-event, unless hydrolysis rules are used.
    }
    *np = n;
 } // choose_cell()
 
 flake *choose_flake(tube *tp)
 {
-   double r,kL,kR;  int oops;   
-   flake_tree *ftp=tp->flake_tree; 
-
-
-   r=drand48();  // we'll re-use this random number for all levels
-   while (ftp->fp==NULL) {
-      kL = ftp->left->rate;
-      kR = ftp->right->rate;
-      /* always fix-up any numerical error that could have accumulated here */
-      assert (ftp->left->fp == NULL || ftp->left->rate >= -0.1);
-      assert (ftp->right->fp == NULL || ftp->right->rate >= -0.1);
-      ftp->rate = ftp->left->rate+ftp->right->rate;
-      do {
-         r = r*(kL+kR);  oops=0;
-         if ( (r-=kL) < 0) { ftp=ftp->left; r=(r+kL)/kL; } else
-            if ( (r-=kR) < 0) { ftp=ftp->right; r=(r+kR)/kR; } else
-            { r=drand48(); oops=1; }
-      } while (oops);
-   }
-   // upon exit, ftp is now a leaf; ftp->fp is our chosen flake
-   return ftp->fp;
+   double r, res=1;  int k=1;   
+
+
+   r=rng_uniform(&tp->rng);  // re-used, rescaled, for all levels
+   while (k < tp->flake_slots) 
+      k = 2*k + pick_weight(&tp->flake_rates[2*k], 2, &r, &res, &tp->rng);
+   // upon exit, k is a leaf; its flake is our chosen one
+   return tp->flakes[k-tp->flake_slots];
 } // choose_flake()
 
 /* Cell i,j has just dissociated.  Previously, every cell was connected  */
@@ -1277,8 +2499,10 @@ flake *choose_flake(tube *tp)
 #define Fpush(g,i,j) {                                      \
    if (Fempty(g)) head[g]=tail[g]=Qn(i,j);                   \
    else { tp->Fnext[tail[g]]=Qn(i,j); tail[g]=Qn(i,j); }     \
-   if ((((i)+size)%size)==fp->seed_i &&                      \
-         (((j)+size)%size)==fp->seed_j) seeded[ming[g]]=1;     \
+   if (((((i)+size)%size)==fp->seed_i &&                     \
+         (((j)+size)%size)==fp->seed_j) ||                     \
+         Frozen(fp,((i)+size)%size,((j)+size)%size))           \
+      seeded[ming[g]]=1;                                        \
    tp->Fgroup[Qn(i,j)]=g;}
 #define Fpull(g,i,j) { int oldh=head[g];                    \
    i=Qi(head[g]); j=Qj(head[g]);                             \
@@ -1478,21 +2702,23 @@ int locally_fission_proof(flake *fp, int i, int j, int oldn)
 /* repeat 'iters' times. */
 void clean_flake(flake *fp, double X, int iters)
 {
-   int i,j,n;  tube *tp=fp->tube;
+   int i,j,n,i0,i1,j0,j1;  tube *tp=fp->tube;
    int size = (1<<fp->P); int it; int *F;
 
    F = (int *)calloc(size*size, sizeof(int));  /* scratch space */
 
 
    /* first memorize, then remove, to avoid changing rates during removal */
+   /* cells two or more away from the flake have nothing to remove.       */
    for (it=0; it<iters; it++) {
-      for (i=0; i<size; i++)
-         for (j=0; j<size; j++) {
+      flake_box(fp,1,&i0,&i1,&j0,&j1);
+      for (i=i0; i<=i1; i++)
+         for (j=j0; j<=j1; j++) {
             n = fp->Cell(i,j);
             F[i+size*j] = (exp(-Gse(fp,i,j,n)) > X * tp->conc[n]);
          }
-      for (i=0; i<size; i++)
-         for (j=0; j<size; j++) 
+      for (i=i0; i<=i1; i++)
+         for (j=j0; j<=j1; j++) 
             if (F[i+size*j]) {
                // A double tile might be at this position -- if so, we need
                // to remove both sides.  But since the off rate of the
@@ -1526,16 +2752,21 @@ void clean_flake(flake *fp, double X, int iters)
 /* repeat 'iters' times. */
 void fill_flake(flake *fp, double X, int iters)
 {
-   int i,j,n; double secure, most_secure;  tube *tp=fp->tube;
+   int i,j,n,i0,i1,j0,j1,lone=0; double secure, most_secure;  tube *tp=fp->tube;
    int size = (1<<fp->P); int it; int *F;
 
    F = (int *)calloc(size*size, sizeof(int));  /* scratch space */
 
+   /* a cell with no neighbours gets filled only if some X*conc[n] > 1; */
+   /* otherwise only the box around the flake needs to be looked at.    */
+   for (n=1; n<=fp->N; n++) if (X * tp->conc[n] > 1) lone=1;
 
    /* first memorize, then add, to avoid changing rates during removal */
    for (it=0; it<iters; it++) {
-      for (i=0; i<size; i++)
-         for (j=0; j<size; j++) {
+      if (lone) { i0=j0=0; i1=j1=size-1; }
+      else flake_box(fp,1,&i0,&i1,&j0,&j1);
+      for (i=i0; i<=i1; i++)
+         for (j=j0; j<=j1; j++) {
             most_secure=0;
             if (fp->Cell(i,j)==0) for (n=1; n<=fp->N; n++) {
                secure = (exp(-Gse(fp,i,j,n)) - X * tp->conc[n]);
@@ -1544,8 +2775,8 @@ void fill_flake(flake *fp, double X, int iters)
                }
             }
          }
-      for (i=0; i<size; i++)
-         for (j=0; j<size; j++) {
+      for (i=i0; i<=i1; i++)
+         for (j=j0; j<=j1; j++) {
 
             if (F[i+size*j]) change_cell(fp, i, j, F[i+size*j]);
             F[i+size*j] = 0;
@@ -1575,16 +2806,17 @@ void repair_flake(flake *fp, double T, double Gse)
 {
    int i,j,n; tube *tp=fp->tube; int size = (1<<fp->P); 
    int morefill, bestn, numn; double bestGse; int *F; 
-   double minT,bigT; int n1,n2;
+   double minT,bigT; int n1,n2; int i0,i1,j0,j1;
 
    F = (int *)calloc(size*size, sizeof(int));  /* scratch space */
 
    // first, remove all tiles involved with mismatches -- identify, then remove
-   for (i=0; i<size; i++)
-      for (j=0; j<size; j++)  
+   flake_box(fp,0,&i0,&i1,&j0,&j1);
+   for (i=i0; i<=i1; i++)
+      for (j=j0; j<=j1; j++)  
          if ((n=fp->Cell(i,j))>0 && Mism(fp,i,j,n)) F[i+size*j] = 1;
-   for (i=0; i<size; i++)
-      for (j=0; j<size; j++) 
+   for (i=i0; i<=i1; i++)
+      for (j=j0; j<=j1; j++) 
          if (F[i+size*j]) {
             n = fp->Cell(i,j); change_cell(fp, i,j,0); F[i+size*j]=0;
             if (!locally_fission_proof(fp,i,j,n)) /* couldn't quickly confirm... */
@@ -1595,15 +2827,20 @@ void repair_flake(flake *fp, double T, double Gse)
 
    // identify holes -- perform an inefficient fill from the edges of empty space 
    //                -- unfilled, empty cells are "interior"                       
-   for (i=0; i<size; i++) {
-      j=0;      while (j<size && fp->Cell(i,j)==0) { F[i+size*j] = 1; j++; }
-      j=size-1; while (j>=0   && fp->Cell(i,j)==0) { F[i+size*j] = 1; j--; }
-      j=0;      while (j<size && fp->Cell(j,i)==0) { F[j+size*i] = 1; j++; }
-      j=size-1; while (j>=0   && fp->Cell(j,i)==0) { F[j+size*i] = 1; j--; }
+   // everything outside the box around the flake is exterior, so only the box
+   // (with a one-cell empty rim, unless it meets the field edge) is looked at.
+   flake_box(fp,1,&i0,&i1,&j0,&j1);
+   for (i=i0; i<=i1; i++) {
+      j=j0; while (j<=j1 && fp->Cell(i,j)==0) { F[i+size*j] = 1; j++; }
+      j=j1; while (j>=j0 && fp->Cell(i,j)==0) { F[i+size*j] = 1; j--; }
+   }
+   for (j=j0; j<=j1; j++) {
+      i=i0; while (i<=i1 && fp->Cell(i,j)==0) { F[i+size*j] = 1; i++; }
+      i=i1; while (i>=i0 && fp->Cell(i,j)==0) { F[i+size*j] = 1; i--; }
    }
    do { morefill=0;
-      for (i=1; i<size-1; i++)
-         for (j=1; j<size-1; j++)  
+      for (i=MAX(i0,1); i<=MIN(i1,size-2); i++)
+         for (j=MAX(j0,1); j<=MIN(j1,size-2); j++)  
             if (F[i+size*j]==0 && fp->Cell(i,j)==0)  
                if (F[i+1+size*j]==1 || F[i+size*j+size]==1 || 
                      F[i-1+size*j]==1 || F[i+size*j-size]==1) 
@@ -1614,8 +2851,8 @@ void repair_flake(flake *fp, double T, double Gse)
    // fill in interior sites where a unique strength-T tile may be added
    //                -- repeat until no longer possible
    do { morefill=0;
-      for (i=0; i<size; i++)
-         for (j=0; j<size; j++)  
+      for (i=i0; i<=i1; i++)
+         for (j=j0; j<=j1; j++)  
             if (fp->Cell(i,j)==0 && F[i+size*j]==0) {
                bestn=0; numn=0;
                for (n=1; n<=fp->N; n++) if (Gse(fp,i,j,n)>=T*Gse) { bestn=n; numn++; }
@@ -1634,13 +2871,13 @@ void repair_flake(flake *fp, double T, double Gse)
    bestGse=0;
    for (n1=1; n1<=tp->N; n1++) 
       for (n2=1; n2<=tp->N; n2++) 
-         bestGse=MAX(bestGse,MAX(tp->Gse_NS[n1][n2],tp->Gse_EW[n1][n2]));
+         bestGse=MAX(bestGse,MAX(Gse_NS(tp, n1, n2),Gse_EW(tp, n1, n2)));
    bigT=ceil(4*bestGse/Gse); // over-estimate max bond-strength to hold in a single tile
 
    for (minT=bigT; minT>-1; minT-=1.0)
       do { morefill=0;
-         for (i=0; i<size; i++)
-            for (j=0; j<size; j++)  
+         for (i=i0; i<=i1; i++)
+            for (j=j0; j<=j1; j++)  
                if (fp->Cell(i,j)==0 && F[i+size*j]==0) {
                   bestn=0; bestGse=minT*Gse;
                   for (n=1; n<=fp->N; n++) if (Gse(fp,i,j,n)>=bestGse) 
@@ -1660,11 +2897,12 @@ void repair_flake(flake *fp, double T, double Gse)
 /* (also see recalc_G for original #mismatches count, as displayed in window always) */
 void error_radius_flake(flake *fp, double rad)
 {
-   int n,i,j,ii,jj,size=(1<<fp->P),solid, oldmm; 
+   int n,i,j,ii,jj,size=(1<<fp->P),solid, oldmm, i0,i1,j0,j1; 
    oldmm = fp->mismatches;
    fp->mismatches=0; 
-   for (i=0;i<size;i++)
-      for(j=0;j<size;j++) {
+   flake_box(fp,0,&i0,&i1,&j0,&j1);
+   for (i=i0;i<=i1;i++)
+      for(j=j0;j<=j1;j++) {
          if ((n=fp->Cell(i,j))>0 && Mism(fp,i,j,n)) {
             solid=1;
             for (ii=MAX(0,floor(i-rad)); ii<=MIN(size-1,ceil(i+rad)); ii++)
@@ -1838,14 +3076,14 @@ void update_all_rates(tube *tp) {
    }
 }
 
-void get_random_wander_permutation (int di[6], int dj[6], 
+void get_random_wander_permutation (xgrow_rng *rng, int di[6], int dj[6], 
       int seed_is_double_tile, int seed_is_vdouble_tile) { // FIXME: implement vdouble support
    int perm,x;
    int perm_nums[6];
    if (seed_is_double_tile) {
       int taken[6] = {0,0,0,0,0,0};
       int posx;
-      perm=random()%720;
+      perm=rng_int(rng,720);
       for (x = 0; x < 6; x++) {
          posx = perm%(6-x);
          perm_nums[x]=0;
@@ -1892,7 +3130,7 @@ void get_random_wander_permutation (int di[6], int dj[6],
    else if (seed_is_vdouble_tile) {
       int taken[6] = {0,0,0,0,0,0};
       int posx;
-      perm=random()%720;
+      perm=rng_int(rng,720);
       for (x = 0; x < 6; x++) {
          posx = perm%(6-x);
          perm_nums[x]=0;
@@ -1938,7 +3176,7 @@ void get_random_wander_permutation (int di[6], int dj[6],
    }
    else {
       int taken[4] = {0,0,0,0}, posx;
-      perm = random()%24;
+      perm = rng_int(rng,24);
       for (x = 0; x < 4; x++) {
          posx = perm%(4-x);
          perm_nums[x]=0;
@@ -1977,11 +3215,218 @@ void get_random_wander_permutation (int di[6], int dj[6],
 }
 
 
+/* [atam] the irreversible Tile Assembly Model without rates.  the     */
+/* frontier is every empty site where some tile could attach; a site   */
+/* goes in when a neighbour's arrival first lets a tile attach there,   */
+/* and so, since bonds are only ever added, it goes in once.  what can  */
+/* attach is read off the site's signature (see sig_lookup) when it is  */
+/* taken, as later neighbours may have changed it.  each attachment     */
+/* moves time on by its mean wait, 1/(k [tile] #sites), with [tile] =   */
+/* exp(-Gmc): exact in expectation for equal concentrations, but the    */
+/* order in which sites fill doesn't depend on concentrations at all.   */
+
+/* could some tile attach at empty site x,y, if the neighbour on side d */
+/* (N E S W) were empty?  and as things are, if d < 0                   */
+static int atam_open(flake *fp, int x, int y, int d)
+{
+   tube *tp=fp->tube;  int id;
+   int c[4] = { BondClass(tp,fp->Cell(x-1,y),2), BondClass(tp,fp->Cell(x,y+1),3),
+                BondClass(tp,fp->Cell(x+1,y),0), BondClass(tp,fp->Cell(x,y-1),1) };
+   if (d>=0) c[d]=0;
+   id = sig_lookup(tp,c[0],c[1],c[2],c[3]);
+   return id>=0 && tp->sigs[id].ntiles>0;
+}
+
+static void atam_push(tube *tp, flake *fp, int i, int j)
+{
+   atam_site *s;
+   if (tp->atam_n == tp->atam_cap && tp->atam_head > 0) {  /* fifo: slide down */
+      memmove(tp->atam_front, tp->atam_front+tp->atam_head, 
+            sizeof(atam_site)*(tp->atam_n-tp->atam_head));
+      tp->atam_n -= tp->atam_head;  tp->atam_head = 0;
+   }
+   if (tp->atam_n == tp->atam_cap) {
+      tp->atam_cap = MAX(64,2*tp->atam_cap);
+      tp->atam_front = (atam_site *)realloc(tp->atam_front, sizeof(atam_site)*tp->atam_cap);
+   }
+   s = &tp->atam_front[tp->atam_n++];
+   s->fp = fp;  s->i = i;  s->j = j;
+}
+
+/* every open site of every flake, row by row */
+static void atam_rebuild(tube *tp)
+{
+   flake *fp;  int i,j,i0,i1,j0,j1;
+   tp->atam_head = tp->atam_n = 0;
+   for (fp=tp->flake_list; fp!=NULL; fp=fp->next_flake) {
+      flake_box(fp,1,&i0,&i1,&j0,&j1);
+      for (i=i0; i<=i1; i++) for (j=j0; j<=j1; j++) 
+         if (fp->Cell(i,j)==0 && atam_open(fp,i,j,-1)) atam_push(tp,fp,i,j);
+   }
+   tp->atam_events = tp->events;
+}
+
+/* put tile n at i,j, and open up the neighbouring sites it lets a tile */
+/* attach at                                                            */
+static void atam_attach(flake *fp, int i, int j, Trep n)
+{
+   static const int di[4]={-1,0,1,0}, dj[4]={0,1,0,-1};
+   int d, x, y, size=(1<<fp->P);
+   change_cell(fp,i,j,n);
+   for (d=0; d<4; d++) {
+      x = i+di[d];  y = j+dj[d];
+      if (periodic) { x=(x+size)%size; y=(y+size)%size; }
+      else if (x<0 || x>=size || y<0 || y>=size) continue;
+      if (fp->Cell(x,y)==0 && atam_open(fp,x,y,-1) && !atam_open(fp,x,y,(d+2)%4))
+         atam_push(fp->tube,fp,x,y);
+   }
+}
+
+/* simulate() for tp->atam: take open sites, at random or first come   */
+/* first served, and fill each with a tile that can go there (in fifo   */
+/* order, the lowest-numbered one), until a limit or nothing is open.   */
+/* a site where more than one tile type could go is counted in          */
+/* atam_nondet.                                                         */
+static void atam_simulate(tube *tp, evint emaxL, double tmax, int smax, int fsmax, int smin, int mmax)
+{
+   double unit = 1/(tp->k*exp(-tp->Gmc)), w, c;  int k, t, m, id;
+   atam_site s;  flake *fp;  site_sig *sp;  Trep n, first[2];
+
+   if (tp->atam_n < 0 || tp->atam_events != tp->events) atam_rebuild(tp);
+   while (tp->atam_n > tp->atam_head && tp->events < emaxL && 
+         (tmax==0 || tp->t < tmax) && 
+         (smax==0 || tp->stat_a-tp->stat_d < smax) &&
+         (mmax==0 || tp->stat_m < mmax) &&
+         (fsmax==0 || tp->largest_flake_size < fsmax) &&
+         (smin==-1 || tp->stat_a-tp->stat_d > smin) &&
+         !(untiltiles && tp->all_present)) {
+
+      tp->t += unit/(tp->atam_n - tp->atam_head);
+      if (tp->atam == 1) {
+         k = tp->atam_head + rng_int(&tp->rng, tp->atam_n - tp->atam_head);
+         s = tp->atam_front[k];  tp->atam_front[k] = tp->atam_front[--tp->atam_n];
+      }
+      else s = tp->atam_front[tp->atam_head++];
+      fp = s.fp;
+      if (fp->Cell(s.i,s.j)!=0 || (id=site_signature(fp,s.i,s.j)) < 0) continue;
+
+      /* the tile types that could go here and haven't run out */
+      sp = &tp->sigs[id];
+      for (t=0, m=0, w=0; t<sp->ntiles; t++) {
+         n = sp->tiles[t];
+         if (tp->conc[n] <= fp->flake_conc) continue;
+         if (m<2) first[m]=n;
+         m++;  w += tp->conc[n];
+      }
+      if (m==0) continue;
+      if (m>1 && tp->atam_nondet++ == 0) {
+         tp->atam_nd_flake = fp->flake_ID;
+         tp->atam_nd_i = s.i+fp->origin_i;  tp->atam_nd_j = s.j+fp->origin_j;
+         tp->atam_nd_n[0] = first[0];  tp->atam_nd_n[1] = first[1];
+      }
+      n = first[0];
+      if (m>1 && tp->atam == 1) {  /* in proportion to concentration */
+         c = w*rng_uniform(&tp->rng);
+         for (t=0; t<sp->ntiles; t++) {
+            if (tp->conc[sp->tiles[t]] <= fp->flake_conc) continue;
+            n = sp->tiles[t];
+            if ((c -= tp->conc[n]) < 0) break;
+         }
+      }
+      atam_attach(fp,s.i,s.j,n);
+
+      if (tp->P < tp->max_P && flake_cramped(fp)) { expand_tube(tp); atam_rebuild(tp); }
+   }
+   tp->atam_events = tp->events;
+}
+
+/* [flicker] cell x,y as it would be with tile n at i,j */
+static Trep flicker_cell(flake *fp, int x, int y, int i, int j, Trep n)
+{
+   int size=(1<<fp->P);
+   if (periodic) { x=(x+size)%size; y=(y+size)%size; }
+   return (x==i && y==j) ? n : fp->Cell(x,y);
+}
+
+/* [flicker] how much the tube's rate outside cell i,j would change if  */
+/* tile n attached there: each empty neighbour gets a new signature, and */
+/* each tile neighbour gains the bond with n.  a neighbour set aside by  */
+/* freeze= is taken to wake up if its new off-rate clears the threshold  */
+/* as it is now, before the attachment.                                  */
+static double flicker_dR(flake *fp, int i, int j, Trep n)
+{
+   static const int di[4]={-1,0,1,0}, dj[4]={0,1,0,-1};
+   tube *tp=fp->tube;  int size=(1<<fp->P), d, e, a, b, k, id, t;
+   Trep m, nb[4];  double dR=0, r, r1, g;  float fr;  flake_page *pg;
+
+   for (d=0; d<4; d++) {
+      a=i+di[d]; b=j+dj[d];
+      if (periodic) { a=(a+size)%size; b=(b+size)%size; }
+      else if (a<0 || a>=size || b<0 || b>=size) continue;
+      if (Frozen(fp,a,b)) continue;
+      if ((m=fp->Cell(a,b))==0) {
+         if ((id=site_signature(fp,a,b))>=0)
+            for (t=0; t<tp->sigs[id].ntiles; t++) dR -= tp->k*tp->conc[tp->sigs[id].tiles[t]];
+         for (e=0; e<4; e++) nb[e]=flicker_cell(fp,a+di[e],b+dj[e],i,j,n);
+         id = sig_lookup(tp, BondClass(tp,nb[0],2), BondClass(tp,nb[1],3),
+               BondClass(tp,nb[2],0), BondClass(tp,nb[3],1));
+         for (t=0; id>=0 && t<tp->sigs[id].ntiles; t++) dR += tp->k*tp->conc[tp->sigs[id].tiles[t]];
+      } else {
+         pg = cell_page(fp,(a<<fp->P)+b,&k);
+         r = pg ? pg->rate[PageLevel(fp->page_bits)+k] : 0;
+         fr = frozen_at(fp, Morton(a,b)>>(2*fp->page_bits), k);
+         if (r==0 && fr==0) continue;
+         g = d==0 ? Gse_NS(tp,m,n) : d==1 ? Gse_EW(tp,m,n) : d==2 ? Gse_NS(tp,n,m) : Gse_EW(tp,n,m);
+         r1 = (r + fr)*exp(-g);
+         if (tp->freeze>0 && fp->flake_index>=0 &&
+               r1 < tp->freeze*tp->flake_rates[tp->flake_slots+fp->flake_index]) r1 = 0;
+         dR += r1 - r;
+      }
+   }
+   return dR;
+}
+
+/* [Gfc] whether there's enough of tile n left for the flake to take    */
+/* it: change_cell() takes flake_conc of n, and of the seed too while   */
+/* the flake is a monomer.  the on-rate is k conc[n] a site whatever    */
+/* the flake's flake_conc, so an on-event for which there isn't enough  */
+/* comes to nothing, as one at the seed does.                           */
+static int enough_conc(flake *fp, Trep n)
+{
+   tube *tp=fp->tube;  double c=fp->flake_conc;
+   int mono = fp->tiles == ((fp->seed_is_double_tile || fp->seed_is_vdouble_tile) ? 2 : 1);
+   if (c<=0) return 1;
+   if (!mono) return tp->conc[n] > c;
+   return tp->conc[n] > (n==fp->seed_n ? 2*c : c) && tp->conc[fp->seed_n] > c;
+}
+
+/* [kernel] a run needs none of the generic variant's extras: kTAM,     */
+/* single tiles that aren't hydrolysed, no chunk fission, wander,       */
+/* tinybox, blast, untiltiles or periodic boundaries.  freeze is left   */
+/* out too: it relies on the diagonal rate updates to wake tiles it     */
+/* set aside.  runs are as likely as before, but not step for step the  */
+/* same for a given rand=, since fewer updates reorder the site lists.  */
+static int plain_kernel(tube *tp)
+{
+   int n;
+   if (tp->T>0 || tp->hydro || periodic || wander || fission_allowed==F_CHUNK ||
+         tp->tinybox>0 || blast_rate>0 || present_list_len || tp->freeze>0 || tp->atam)
+      return 0;
+   for (n=1; n<=tp->N; n++) 
+      if (tp->dt_right[n] || tp->dt_left[n] || tp->dt_down[n] || tp->dt_up[n]) return 0;
+   return 1;
+}
+
+#define CHANGE_CELL(fp,i,j,n) \
+   (plain ? change_cell_plain(fp,i,j,n) : change_cell(fp,i,j,n))
+
 /* simulates 'events' events */
-void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax, int smin, int mmax)
+KERNEL void simulate_k(tube *tp, evint events, double tmax, int emax, int smax, int fsmax, int smin, int mmax,
+      const int plain)
 {
    int i,j,n,oldn; double dt; flake *fp; int chunk, seedchunk[4];
    double total_rate, total_blast_rate, new_flake_rate, event_choice; long int emaxL;
+   double on_rate, off_rate;  int on_event, flicker_ok, big=(tp->big_flakes>0);
    int size=(1<<tp->P), N=tp->N;  
    if (tp->flake_list==NULL && tp->tinybox == 0) return;  /* no flakes! */
 
@@ -2001,46 +3446,45 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
 
    emaxL = (emax==0 || tp->events+events<emax)?(tp->events+events):emax;
 
+   /* chunk fission may have been switched on from the GUI; its pair and */
+   /* 2x2 off-rates don't fit the strength classes, so go back to the    */
+   /* plain rate pyramid (recalc_G empties the classes)                  */
+   if (tp->off_lazy && fission_allowed==F_CHUNK) { 
+      tp->off_lazy=0; update_all_rates(tp); 
+   }
 
-   fp=tp->flake_list; 
-   /* Ensure that there are either reasonable seeds in each flake, or
-    * we are using tinybox.
-    */
-   while (fp!=NULL) {  
-
-      assert (!tp->tinybox || (((!fp->seed_is_double_tile && !fp->seed_is_vdouble_tile) && fp->tiles > 1) || fp->tiles > 2));
-
-      //printf("Seed is tile %d at %d,%d.\n",fp->seed_n,fp->seed_i,fp->seed_j);
-      if (periodic) {
-         assert(fp->Cell((fp->seed_i+size)%size,(fp->seed_j+size)%size) == fp->seed_n);
-      } else {
-         assert(fp->Cell(fp->seed_i,fp->seed_j) == fp->seed_n);
-      }
 
+   /* a flake may start out (or have been left) close to the edge; after  */
+   /* one doubling, none is [maxsize]; once the field is full size, the   */
+   /* window moves instead [slide]                                        */
+   for (fp=tp->flake_list; fp!=NULL && tp->P < tp->max_P; fp=fp->next_flake)
+      if (flake_cramped(fp)) { expand_tube(tp); size=(1<<tp->P); break; }
+   if (tp->P >= tp->max_P && tp->slide_dir>=0)
+      for (fp=tp->flake_list; fp!=NULL; fp=fp->next_flake)
+         if (flake_at_front(fp)) slide_flake(fp);
 
-      if (tp->dt_right[fp->seed_n]) {
-         assert(fp->Cell(fp->seed_i,fp->seed_j+1) == tp->dt_right[fp->seed_n]);
-      }
-      if (tp->dt_left[fp->seed_n]) {
-         assert(fp->Cell(fp->seed_i,fp->seed_j-1) == tp->dt_left[fp->seed_n]);
-      }
-      if (tp->dt_down[fp->seed_n]) {
-         assert(fp->Cell(fp->seed_i+1,fp->seed_j) == tp->dt_down[fp->seed_n]);
-      }
-      if (tp->dt_up[fp->seed_n]) {
-         assert(fp->Cell(fp->seed_i-1,fp->seed_j) == tp->dt_up[fp->seed_n]);
-      }
-      fp=fp->next_flake;
-   }
+   if (tp->atam) { atam_simulate(tp,emaxL,tmax,smax,fsmax,smin,mmax); return; }
 
-   if (tp->flake_tree) {
-      total_rate = tp->flake_tree->rate;
+   if (tp->num_flakes>0) {
+      total_rate = tp->flake_rates[1] + tube_on_rate(tp);
    }
    else {
       total_rate = 0;
    }
-   total_blast_rate = tp->k*tp->conc[0]*blast_rate*size*size*tp->num_flakes;
-   new_flake_rate = tp->k*2*pow(tp->conc[0],2)*tp->tinybox*AVOGADROS_NUMBER ;
+   if (plain) total_blast_rate = new_flake_rate = 0;
+   else {
+      total_blast_rate = tp->k*tp->conc[0]*blast_rate*size*size*tp->num_flakes;
+      new_flake_rate = tp->k*2*pow(tp->conc[0],2)*tp->tinybox*AVOGADROS_NUMBER ;
+   }
+
+   /* [flicker] only for plain kTAM growth, where the only events are tile */
+   /* events, nothing happens between them, and a just-attached tile's    */
+   /* off-rate is k exp(-Gse) of its bonds                                */
+   flicker_ok = tp->flicker>0 && tp->T==0 && !tp->hydro && !wander && 
+      fission_allowed!=F_CHUNK && tp->tinybox==0 && blast_rate==0 && 
+      !present_list_len && !tp->anneal_t && !tp->seconds_per_C && !tp->off_lazy;
+   for (n=1; n<=N && flicker_ok; n++) 
+      if (tp->dt_right[n] || tp->dt_left[n] || tp->dt_down[n] || tp->dt_up[n]) flicker_ok=0;
 
    // FIXME: used to have an assert here to check that total overall rate >= 0, but this seems pointless (all rates are >=0)
 
@@ -2062,64 +3506,50 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
       /* First check if time is such that we need to update the temperature [anneal] */
       if (tp->anneal_t && (tp->t > tp->next_update_t)) {
          tp->Gse = tp->Gse_final- (tp->Gse_final - tp->anneal_g)*exp(-tp->t/tp->anneal_t);
-         set_Gses(tp,tp->Gse,0);  // NOT SAFE FOR HYDROLYSIS
          /* Now we have to update all rates */
+         anneal_Gse(tp,tp->Gse);
          tp->updates++;
          tp->next_update_t = tp->updates*tp->anneal_t/tp->update_freq;
-         update_all_rates (tp);
       }
       if (tp->seconds_per_C  && (tp->t > tp->next_update_t)) {
          tp->currentC -= 0.01;
          tp->Gse = (tp->anneal_h - (tp->currentC + 273) * tp->anneal_s) / (k_b*(tp->currentC + 273));
-         set_Gses(tp,tp->Gse,0);  // NOT SAFE FOR HYDROLYSIS
+         anneal_Gse(tp,tp->Gse);
          printf("currentC is %f, Gse is %f\n",tp->currentC, tp->Gse);
          tp->next_update_t += tp->seconds_per_C / 100;
-         update_all_rates (tp);
       }
 
-      /* Check concentrations of double tiles. [doubletile]
-       * FIXME: is this actually necessary? right hand side concentration might be
-       * better off ignored.
-       */
-      for (i = 0; i < N; i++) {
-         if (tp->dt_right[i]) {
-            if (tp->conc[i] != tp->conc[tp->dt_right[i]]) {
-               printf("Concentrations are off!\n");
-            }
-            assert (tp->conc[i] == tp->conc[tp->dt_right[i]]);
-         }
-         if (tp->dt_down[i]) {
-            if (tp->conc[i] != tp->conc[tp->dt_down[i]]) {
-               printf("Concentrations are off!\n");
-            }
-            assert (tp->conc[i] == tp->conc[tp->dt_down[i]]);
-         }
-      }
+      /* double-tile concentrations, seeds and rates are checked here, */
+      /* but only every tp->validate events [validate]                 */
+      if (tp->validate && tp->events >= tp->validate_next) validate_tube(tp);
 
-      if (tp->flake_tree) 
-         total_rate = tp->flake_tree->rate;
-      else
-         total_rate = 0;
-      if (total_rate < 0) printf("ERROR: Total Rate: %f (< 0) in simulate.\n",total_rate);
+      if (tp->num_flakes>0) {
+         off_rate = tp->flake_rates[1];  on_rate = tube_on_rate(tp);
+      } else
+         off_rate = on_rate = 0;
+      total_rate = off_rate + on_rate;
 
-      new_flake_rate = tp->k*2*pow(tp->conc[0],2)*tp->tinybox*AVOGADROS_NUMBER ;
-      total_blast_rate = tp->k*tp->conc[0]*blast_rate*size*size*tp->num_flakes;
+      if (!plain) {
+         new_flake_rate = tp->k*2*pow(tp->conc[0],2)*tp->tinybox*AVOGADROS_NUMBER ;
+         total_blast_rate = tp->k*tp->conc[0]*blast_rate*size*size*tp->num_flakes;
+      }
       if (total_rate + total_blast_rate + new_flake_rate == 0) break;
 
 
       // Choose a time step.
-      dt = -log(drand48()) / (total_rate + total_blast_rate + new_flake_rate);
-      event_choice = drand48()*(total_rate+total_blast_rate+new_flake_rate);
+      dt = rng_exp(&tp->rng) / (total_rate + total_blast_rate + new_flake_rate);
+      if (tp->freeze>0) tp->frozen_missed += MAX(0,tp->frozen_rate)*dt;
+      event_choice = rng_uniform(&tp->rng)*(total_rate+total_blast_rate+new_flake_rate);
 
       /* Now choose one of three possible actions:
        * (1) blast
        * (2) create a new flake
        * (3) have a tile event (kTAM/aTAM)
        */
-      if (blast_rate>0 && event_choice < total_blast_rate) { // blast event (FIXME: not looked at)
+      if (!plain && blast_rate>0 && event_choice < total_blast_rate) { // blast event (FIXME: not looked at)
          int kb=size,ii,jj,ic,jc,di,dj,seed_here,flake_n;
 
-         while(kb==size) { double dr = drand48()*blast_rate;
+         while(kb==size) { double dr = rng_uniform(&tp->rng)*blast_rate;
             for (kb=1; kb<size; kb++)  // choose blast hole size kb= 1...size
                if ( ( dr -= blast_rate_alpha * exp(-blast_rate_gamma*(kb-1)) / pow(kb*1.0,blast_rate_beta) ) < 0 )
                   break; 
@@ -2127,16 +3557,16 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
          // printf("zap! %d x %d\n",kb,kb);
 
          // choose a flake
-         flake_n = random()%(tp->num_flakes); fp=tp->flake_list;  for (i=0; i<flake_n; i++) fp=fp->next_flake;
+         flake_n = rng_int(&tp->rng,tp->num_flakes); fp=tp->flakes[flake_n];
 
-         ic=random()%size; jc=random()%size;  // corner coordinates for kb x kb square to be removed
-         di=2*(random()%2)-1; dj=2*(random()%2)-1;  // square goes in random direction from ic, jc
+         ic=rng_int(&tp->rng,size); jc=rng_int(&tp->rng,size);  // corner coordinates for kb x kb square to be removed
+         di=2*rng_int(&tp->rng,2)-1; dj=2*rng_int(&tp->rng,2)-1;  // square goes in random direction from ic, jc
 
          for (seed_here=0, ii=0; ii<kb; ii++) for (jj=0; jj<kb; jj++) { // make sure seed tile is not in square
             if (periodic) { i=(ic+di*ii+size)%size; j=(jc+dj*jj+size)%size; } else { i=ic+di*ii; j=jc+dj*jj; }
             if (i==fp->seed_i && j==fp->seed_j) seed_here=1;  // square wraps or is cropped
          }
-         if (!seed_here) { int vorh=random()%2;
+         if (!seed_here) { int vorh=rng_int(&tp->rng,2);
             for (ii=0; ii<kb; ii++) for (jj=0; jj<kb; jj++) {
                if (vorh) { if (periodic) { i=(ic+di*ii+size)%size; j=(jc+dj*jj+size)%size; } else { i=ic+di*ii; j=jc+dj*jj; } }
                else      { if (periodic) { i=(ic+di*jj+size)%size; j=(jc+dj*ii+size)%size; } else { i=ic+di*jj; j=jc+dj*ii; } }
@@ -2153,7 +3583,7 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
          }
          tp->t += dt;
       } 
-      else if (new_flake_rate && event_choice < (total_blast_rate + new_flake_rate)) { // new flake event (FIXME: not looked at)
+      else if (!plain && new_flake_rate && event_choice < (total_blast_rate + new_flake_rate)) { // new flake event (FIXME: not looked at)
          int m,r,x,d,c;
 	 // Make sure di, dj are set: start at -10 (impossible) and check:
 	 int di = -10; int dj = -10;
@@ -2166,13 +3596,14 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
          // Make sure enough of each tile is available
          flake_conc = (tp->initial_Gfc>0)?exp(-tp->initial_Gfc):0;
          d2printf("New flake: concentration of tile %d is %e and tile %d is %e and flake conc is %e\n",n,tp->conc[n],m,tp->conc[m],flake_conc);
-         if (tp->conc[n] < flake_conc || tp->conc[m] < flake_conc) {
+         if (tp->conc[n] < flake_conc || tp->conc[m] < flake_conc ||
+               (n==m && tp->conc[n] < 2*flake_conc)) {
             c = 0;
          }
          else {
             // Choose a second cell to add to the new tile to
             // Determine an orientation for the two tiles
-            r = random();
+            r = (long)(rng_next(&tp->rng)>>33);
 
             x = ((r>>2) % 2) * 2 - 1;
             d = r % 2;
@@ -2186,8 +3617,8 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
                   c = 0;
                } 
                else {if (x > 0) {
-                  c = tp->Gse_NS[n][m];
-               } else { c = tp->Gse_NS[m][n]; }}
+                  c = Gse_NS(tp, n, m);
+               } else { c = Gse_NS(tp, m, n); }}
             }
             else {
                // Connect left or right
@@ -2199,8 +3630,8 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
                }
                else {
                   if (x > 0) { 
-                     c = tp->Gse_EW[m][n]; 
-                  } else { c = tp->Gse_EW[n][m]; }
+                     c = Gse_EW(tp, m, n); 
+                  } else { c = Gse_EW(tp, n, m); }
                }
             }
          }
@@ -2270,20 +3701,27 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
       }
       else { // tile (aTAM / kTAM) event
 
-         fp=choose_flake(tp);
+         /* on-events are chosen straight down to the site; off-events by */
+         /* flake first, and the cell after the seed has had its chance   */
+         /* to wander                                                     */
+choose_event:
+         on_event = off_rate<=0 || 
+            event_choice - total_blast_rate - new_flake_rate < on_rate;
+         if (on_event) fp=choose_on_event(tp, &i, &j, &n);
+         else fp=choose_flake(tp);
 
          /* ensure that the seed state in our chosen flake is reasonable */
-         assert (!tp->dt_left[fp->Cell(fp->seed_i,fp->seed_j)]);
-         assert (!tp->dt_up[fp->Cell(fp->seed_i,fp->seed_j)]);
-	 assert (!tp->tinybox || (((!fp->seed_is_double_tile && !fp->seed_is_vdouble_tile) && fp->tiles > 1) || fp->tiles > 2));
+         assert (plain || !tp->dt_left[fp->Cell(fp->seed_i,fp->seed_j)]);
+         assert (plain || !tp->dt_up[fp->Cell(fp->seed_i,fp->seed_j)]);
+	 assert (plain || !tp->tinybox || (((!fp->seed_is_double_tile && !fp->seed_is_vdouble_tile) && fp->tiles > 1) || fp->tiles > 2));
 	 
          /* let the designated seed site wander around */
          /* must do this very frequently, else treadmilling would get stuck FIXME: not looked at */
-         if (wander) {  
+         if (!plain && wander) {  
             int new_i, new_j;
             // Pick a new seed adjacent to the old one
-            new_i = fp->seed_i-1+random()%3;
-            new_j = fp->seed_j-1+random()%3;
+            new_i = fp->seed_i-1+rng_int(&tp->rng,3);
+            new_j = fp->seed_j-1+rng_int(&tp->rng,3);
             if (periodic  || (new_i>=0 && new_i<size && new_j>=0 && new_j<size)) {
                //printf("Size is %d, new_i is %d, new_j is %d.\n",size,new_i,new_j);
                if (periodic) { new_i=(new_i+size)%size; new_j=(new_j+size)%size; }
@@ -2308,7 +3746,7 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
                if (e) {
                   // Find a random new tile
                   while (tp->conc[fp->seed_n] < fp->flake_conc || tp->dt_left[fp->seed_n] || tp->dt_up[fp->seed_n]) {
-                     fp->seed_n=(random()%N)+1; 
+                     fp->seed_n=rng_int(&tp->rng,N)+1; 
                   }
                   change_cell(fp,fp->seed_i,fp->seed_j,0);
                   // In case the old seed was a double tile
@@ -2321,42 +3759,86 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
                   else if (tp->dt_down[fp->seed_n]) {
                      change_cell(fp,fp->seed_i+1,fp->seed_j,tp->dt_down[fp->seed_n]); 
                   }
+                  // an on-event's site was chosen from the old cells, so the
+                  // event is drawn again, with its time, from the new ones
+                  if (on_event) continue;
                }
             }
          }
 
          /* choose a cell to modify, and what the new tile type should tentatively be (0 is detachment) */
-         choose_cell(fp, &i, &j, &n); 
+         if (!on_event) choose_cell(fp, &i, &j, &n); 
          dprintf("Chose cell %d,%d tile %d.\n",i,j,n);
 
+         /* [flicker] a tile that attaches weakly mostly just falls off again.  */
+         /* once it's on, its detachment (rate d) races everything else (rate   */
+         /* R: the tube's rate less the site's own on-rate, plus the changes    */
+         /* the tile makes at its neighbours, see flicker_dR), and the race is  */
+         /* decided here: if the detachment wins, the round trip is counted and */
+         /* timed without touching the flake; if not, the tile goes on and the  */
+         /* next event is drawn without it.                                     */
+         if (tp->flick_fp!=NULL) {
+            if (fp==tp->flick_fp && !on_event && i==tp->flick_i && j==tp->flick_j && n==0) {
+               event_choice = rng_uniform(&tp->rng)*total_rate;
+               goto choose_event;
+            }
+            tp->flick_fp=NULL;
+         }
+         if (flicker_ok && on_event && fp->Cell(i,j)==0 && enough_conc(fp,n) &&
+               (zero_bonds_allowed || HCONNECTED(fp,i,j,n)) &&
+               (tmax==0 || tp->t+dt < tmax) && tp->events+2 < emaxL &&
+               (smax==0 || tp->stat_a-tp->stat_d+1 < smax) &&
+               (mmax==0 || tp->stat_m+Mism(fp,i,j,n) < mmax) &&
+               (fsmax==0 || fp->tiles+1 < fsmax)) {
+            double d = tp->k*exp(-Gse(fp,i,j,n)), R = total_rate;
+            int id = site_signature(fp,i,j), t;
+            for (t=0; id>=0 && t<tp->sigs[id].ntiles; t++) 
+               R -= tp->k*tp->conc[tp->sigs[id].tiles[t]];
+            R = MAX(R + flicker_dR(fp,i,j,n),0);
+            if (d >= tp->flicker*R) {
+               if (rng_uniform(&tp->rng)*(d+R) < d) {
+                  if (fp->tiles+1 > tp->largest_flake_size) {
+                     tp->largest_flake = fp->flake_ID;
+                     tp->largest_flake_size = fp->tiles+1;
+                  }
+                  tp->stat_a++; tp->stat_d++; tp->events+=2; fp->events+=2;
+                  tp->flickers++;
+                  tp->t += dt + rng_exp(&tp->rng)/(d+R);
+                  continue;
+               }
+               tp->flick_fp=fp; tp->flick_i=i; tp->flick_j=j;
+            }
+         }
+
          chunk = 0;
-         if (fission_allowed==F_CHUNK && n==0) { // for chunk fission, decide on a chunk type [chunk_fission] 
-            double sum=0, rsum; 
+         if (!plain && fission_allowed==F_CHUNK && n==0) { // for chunk fission, decide on a chunk type [chunk_fission] 
+            double sum=0, r, res=1; 
             sum = calc_rates(fp,i,j,tp->rv); 
-            rsum=sum*drand48();
             if (sum == 0) {
                // If our total rate is zero, we'll simply choose to detach a single tile
                // FIXME: can this happen in a non-bug fashion?
                chunk = 0;
             }
             else {
-               for (chunk=0; chunk<4; chunk++) 
-                  if (rsum<tp->rv[1+N+chunk]) break; else rsum-=tp->rv[1+N+chunk];
+               r = rng_uniform(&tp->rng);
+               chunk = pick_weight(&tp->rv[1+N], 4, &r, &res, &tp->rng);
             }
-            if (chunk<0 || chunk>3) printf("impossible chunk chosen!!!\n");
          }
 
          /* FIXME: much of this matters only if chunk_fission is on. In general, can we only calculate the one to match chunk? */
-         seedchunk[0] = ((i   == fp->seed_i && j   == fp->seed_j) ||
-               (tp->dt_right[fp->seed_n] && i == fp->seed_i && j == fp->seed_j + 1) ||
-               (tp->dt_left[fp->seed_n] && i == fp->seed_i && j == fp->seed_j - 1) ||
-               (tp->dt_down[fp->seed_n] && i == fp->seed_i+1 && j == fp->seed_j) ||
-               (tp->dt_up[fp->seed_n] && i == fp->seed_i-1 && j == fp->seed_j));
-         seedchunk[1] = (n==0 && i   == fp->seed_i && j+1 == fp->seed_j) || seedchunk[0];
-         seedchunk[2] = (n==0 && i+1 == fp->seed_i && j   == fp->seed_j) || seedchunk[0];
-         seedchunk[3] = (n==0 && i+1 == fp->seed_i && j+1 == fp->seed_j) || seedchunk[1] || seedchunk[2];
-
-         if (wander && n==0) { // If [wander] is on, try to move the seed tile if it is set to be removed. FIXME: not looked at
+         if (plain) seedchunk[0] = (i == fp->seed_i && j == fp->seed_j);  /* chunk is 0 */
+         else {
+            seedchunk[0] = ((i   == fp->seed_i && j   == fp->seed_j) ||
+                  (tp->dt_right[fp->seed_n] && i == fp->seed_i && j == fp->seed_j + 1) ||
+                  (tp->dt_left[fp->seed_n] && i == fp->seed_i && j == fp->seed_j - 1) ||
+                  (tp->dt_down[fp->seed_n] && i == fp->seed_i+1 && j == fp->seed_j) ||
+                  (tp->dt_up[fp->seed_n] && i == fp->seed_i-1 && j == fp->seed_j));
+            seedchunk[1] = (n==0 && i   == fp->seed_i && j+1 == fp->seed_j) || seedchunk[0];
+            seedchunk[2] = (n==0 && i+1 == fp->seed_i && j   == fp->seed_j) || seedchunk[0];
+            seedchunk[3] = (n==0 && i+1 == fp->seed_i && j+1 == fp->seed_j) || seedchunk[1] || seedchunk[2];
+         }
+
+         if (!plain && wander && n==0) { // If [wander] is on, try to move the seed tile if it is set to be removed. FIXME: not looked at
             int new_i=fp->seed_i, new_j=fp->seed_j;
             if (chunk==0 && seedchunk[0]) {
                // looks like we're trying to dissociate the seed tile.
@@ -2365,7 +3847,7 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
                int mi[6],mj[6], x, limit;
                assert (!tp->dt_left[fp->seed_n]);
                assert (!tp->dt_up[fp->seed_n]);
-               get_random_wander_permutation (mi, mj, fp->seed_is_double_tile, fp->seed_is_vdouble_tile);
+               get_random_wander_permutation (&tp->rng, mi, mj, fp->seed_is_double_tile, fp->seed_is_vdouble_tile);
                if (fp->seed_is_double_tile || fp->seed_is_vdouble_tile) {
                   limit = 6;
                }
@@ -2411,7 +3893,7 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
                if (periodic) { new_i = (new_i+size)%size; new_j = (new_j+size)%size; }
             } else if (chunk==1 && seedchunk[1]) {
 	      // FIXME: this doesn't work for double tiles at all!
-               int mi,mj,mk; mi=((random()/17)%2)*2-1; mj=((random()/17)%2)*3-1; mk=(random()/17)%2;
+               int mi,mj,mk; mi=rng_int(&tp->rng,2)*2-1; mj=rng_int(&tp->rng,2)*3-1; mk=rng_int(&tp->rng,2);
                if      (fp->Cell(i-mi,j+mk)!=0)   { new_i=i-mi; new_j=j+mk; }
                else if (fp->Cell(i+mi,j+mk)!=0)   { new_i=i+mi; new_j=j+mk; }
                else if (fp->Cell(i-mi,j+1-mk)!=0) { new_i=i-mi; new_j=j+1-mk; }
@@ -2419,7 +3901,7 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
                else if (fp->CellM(i,j-mj+1)!=0)   { new_i=i;    new_j=j-mj+1; }
                else if (fp->CellM(i,j+mj)!=0)     { new_i=i;    new_j=j+mj; }
             } else if (chunk==2 && seedchunk[2]) {
-               int mi,mj,mk; mi=((random()/17)%2)*3-1; mj=((random()/17)%2)*2-1; mk=(random()/17)%2;
+               int mi,mj,mk; mi=rng_int(&tp->rng,2)*3-1; mj=rng_int(&tp->rng,2)*2-1; mk=rng_int(&tp->rng,2);
                if      (fp->Cell(i+mk,j+mj)!=0)   { new_i=i+mk;   new_j=j+mj; }
                else if (fp->Cell(i+mk,j-mj)!=0)   { new_i=i+mk;   new_j=j-mj; }
                else if (fp->Cell(i+1-mk,j+mj)!=0) { new_i=i+1-mk; new_j=j+mj; }
@@ -2427,7 +3909,7 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
                else if (fp->CellM(i-mi+1,j)!=0)   { new_i=i-mi+1; new_j=j; }
                else if (fp->CellM(i+mi,j)!=0)     { new_i=i+mi;   new_j=j; }
             } else if (chunk==3 && seedchunk[3]) {
-               int mi,mj,mk; mi=((random()/17)%2)*3-1; mj=((random()/17)%2)*3-1; mk=(random()/17)%2;
+               int mi,mj,mk; mi=rng_int(&tp->rng,2)*3-1; mj=rng_int(&tp->rng,2)*3-1; mk=rng_int(&tp->rng,2);
                if      (fp->CellM(i-mi+1,j+mk)!=0)   { new_i=i-mi+1; new_j=j+mk; }
                else if (fp->CellM(i+mi,j+mk)!=0)     { new_i=i+mi; new_j=j+mk; }
                else if (fp->CellM(i-mi+1,j+1-mk)!=0) { new_i=i-mi+1; new_j=j+1-mk; }
@@ -2467,9 +3949,14 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
          //     if (seedchunk[chunk]) 
          //       printf("seedchunk triggered by %d,%d chunk %d !\n",i,j,chunk);
 
-         if (!seedchunk[chunk]) { /* only make a change if we aren't changing a seed tile */
+         if (on_event && !enough_conc(fp,n)) {
+            /* there isn't enough of n left for this flake: no change, but */
+            /* it counts, or a flake short of its seed tile would keep the */
+            /* tube from ever reaching emax [Gfc]                          */
+            tp->events++; fp->events++;
+         } else if (!seedchunk[chunk]) { /* only make a change if we aren't changing a seed tile */
 
-            if (tp->T>0) { /* irreversible Tile Assembly Model */
+            if (!plain && tp->T>0) { /* irreversible Tile Assembly Model */
 
                /* If the tile can attach, then have it attach.
                 * FIXME: conc check here is a hack.
@@ -2505,9 +3992,10 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
                if (zero_bonds_allowed==0) { /* [zero_bonds] is not set, so require connectivity. */
 
                   if (oldn==0 && HCONNECTED(fp,i,j,n) && 
-                        double_tile_allowed(tp,fp,i,j,n)) {
-                     change_cell(fp,i,j,n);
-                     if (tp->dt_right[n])
+                        (plain || double_tile_allowed(tp,fp,i,j,n))) {
+                     CHANGE_CELL(fp,i,j,n);
+                     if (plain) ;
+                     else if (tp->dt_right[n])
                         change_cell(fp,i,j+1,tp->dt_right[n]);
                      else if (tp->dt_left[n])
                         change_cell(fp,i,j-1,tp->dt_left[n]);
@@ -2523,9 +4011,10 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
                   if (oldn==0 && !HCONNECTED(fp,i,j,n)) 
                   { tp->stat_a++; tp->stat_d++; tp->events+=2; fp->events+=2; } 
                }
-               else if (oldn==0 && double_tile_allowed(tp,fp,i,j,n)) { /* [zero_bonds is set, so let any attachment happen */
-                  change_cell(fp,i,j,n);
-                  if (tp->dt_right[n])
+               else if (oldn==0 && (plain || double_tile_allowed(tp,fp,i,j,n))) { /* [zero_bonds is set, so let any attachment happen */
+                  CHANGE_CELL(fp,i,j,n);
+                  if (plain) ;
+                  else if (tp->dt_right[n])
                     change_cell(fp,i,j+1,tp->dt_right[n]);
                   else if (tp->dt_left[n])
                     change_cell(fp,i,j-1,tp->dt_left[n]);
@@ -2543,7 +4032,7 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
 
                if (n==0) {  
                   int d, k, dn, di[7], dj[7], oldns[7], removals[7];
-                  if      (chunk==0 && !tp->dt_right[oldn] && !tp->dt_down[oldn]) { 
+                  if      (plain || (chunk==0 && !tp->dt_right[oldn] && !tp->dt_down[oldn])) { 
                      dn=1; di[0]=i; dj[0]=j; 
                   }
                   else if (chunk==1 || (chunk==0 && tp->dt_right[oldn]) ) { 
@@ -2591,11 +4080,11 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
                      removals[0] = 0;
                   }
                   for (d=0; d<dn; d++) { // delete each tile to be removed
-                     i=di[removals[d]]; j=dj[removals[d]]; if (periodic) { i=(i+size)%size; j=(j+size)%size; }
+                     i=di[removals[d]]; j=dj[removals[d]]; if (!plain && periodic) { i=(i+size)%size; j=(j+size)%size; }
                      oldns[removals[d]]=fp->Cell(i,j); // must make sure oldn is correct for each tile in chunk
                      if (i==fp->seed_i && j==fp->seed_j)
                         fprintf(stderr,"removing seed at %d, %d! chunk=%d from %d,%d\n",i,j,chunk,di[0],dj[0]);
-                     change_cell(fp,i,j,0);
+                     CHANGE_CELL(fp,i,j,0);
                      if (!locally_fission_proof(fp,i,j,oldns[removals[d]])) { /* couldn't quickly confirm... */
                         if (flake_fission(fp,i,j)) {
                            if (fission_allowed==0) {
@@ -2614,7 +4103,7 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
                               // doesn't remove cells if fission_allowed==0.)
 
                               for (k=0; k<=d; k++) {
-                                 change_cell(fp,di[removals[k]],dj[removals[k]],oldns[removals[k]]); tp->stat_a--; tp->stat_d--;
+                                 CHANGE_CELL(fp,di[removals[k]],dj[removals[k]],oldns[removals[k]]); tp->stat_a--; tp->stat_d--;
                               }
                               // If we are watching states to count how often they are entered, we 
                               // didn't actually leave the state we thought we left.
@@ -2644,31 +4133,650 @@ void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax
             assert (0);
          }
          // If we are using tinybox and only a single tile is left, remove the flake
-         if (tp->tinybox && 
+         if (!plain && tp->tinybox && 
 	     (fp->tiles == 1 || (fp->tiles == 2 && (fp->seed_is_double_tile || fp->seed_is_vdouble_tile)))) {
             remove_flake(fp);
             d2printf("Removed flake.  There are now %d flakes remaining.\n",tp->num_flakes);
          }
          else {
             // Check that the flake rate is still positive
-            if (fp->tree_node->rate < 0) {
+            if (tp->flake_rates[tp->flake_slots+fp->flake_index] < 0) {
                fprintf(stderr,"Bad news, negative rate\n");
                assert(0);
             }
          }
          d2printf("%d,%d -> %d\n",i,j,n);
       } // end of kTAM / aTAM section
-      /*
-         if (tp->flake_tree) 
-         total_rate = tp->flake_tree->rate+tp->k*tp->conc[0]*tp->flake_tree->empty;
-         else
-         total_rate = 0;
-         assert (total_rate >= 0);
-         total_blast_rate = tp->k*tp->conc[0]*blast_rate*size*size*tp->num_flakes;
-         */
+
+      /* make room before the flake can feel the edge [maxsize] [slide] */
+      if (fp!=NULL && fp->tube==tp) {
+         if (tp->P < tp->max_P && flake_cramped(fp)) {
+            expand_tube(tp);  size=(1<<tp->P);
+         }
+         else if (tp->P >= tp->max_P && tp->slide_dir>=0 && flake_at_front(fp))
+            slide_flake(fp);
+      }
+
+      /* stop when the first flake gets to big_size, or the last one drops */
+      /* back below it [ffs]                                              */
+      if (tp->big_size>0 && (tp->big_flakes>0) != big) break;
    } // end while
-} // simulate
+} // simulate_k()
+#undef CHANGE_CELL
+
+void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax, int smin, int mmax)
+{
+   if (plain_kernel(tp)) simulate_k(tp,events,tmax,emax,smax,fsmax,smin,mmax,1);
+   else simulate_k(tp,events,tmax,emax,smax,fsmax,smin,mmax,0);
+}
+
+
+/* [ffs] size of the largest flake now (tp->largest_flake_size is the */
+/* largest ever)                                                      */
+int largest_flake_now(tube *tp)
+{
+   int m=0;  flake *fp;
+   for (fp=tp->flake_list; fp!=NULL; fp=fp->next_flake) m=MAX(m,fp->tiles);
+   return m;
+}
+
+tube_state *save_tube(tube *tp)
+{
+   tube_state *s = (tube_state *)calloc_err(1,sizeof(tube_state));
+   int i,j,i0,i1,j0,j1,f=0,x=0,len=0,m,*c;  flake *fp;
+
+   for (fp=tp->flake_list; fp!=NULL; fp=fp->next_flake) {
+      flake_box(fp,0,&i0,&i1,&j0,&j1);  len += 6;
+      for (i=i0;i<=i1;i++) for (j=j0;j<=j1;j++) if (fp->Cell(i,j)) len += 3;
+      s->num_flakes++;
+   }
+   s->conc = (double *)calloc_err(sizeof(double),tp->N+1);
+   memcpy(s->conc, tp->conc, (tp->N+1)*sizeof(double));
+   s->cells = (int *)calloc_err(sizeof(int),MAX(1,len));  s->len = len;
+   s->flake_conc = (double *)calloc_err(sizeof(double),MAX(1,s->num_flakes));
+   s->flake_ID = (int *)calloc_err(sizeof(int),MAX(1,s->num_flakes));
+   for (fp=tp->flake_list; fp!=NULL; fp=fp->next_flake) {
+      c = s->cells+x;  m = 0;
+      c[0]=fp->seed_i; c[1]=fp->seed_j; c[2]=fp->seed_n;
+      c[3]=fp->seed_is_double_tile; c[4]=fp->seed_is_vdouble_tile;
+      flake_box(fp,0,&i0,&i1,&j0,&j1);
+      for (i=i0;i<=i1;i++) for (j=j0;j<=j1;j++) 
+         if (fp->Cell(i,j)) { c[6+3*m]=i; c[7+3*m]=j; c[8+3*m]=fp->Cell(i,j); m++; }
+      c[5]=m;  x += 6+3*m;
+      s->flake_ID[f] = fp->flake_ID;  s->flake_conc[f++] = fp->flake_conc;
+   }
+   s->size = largest_flake_now(tp);  s->parent = -1;
+   s->total_flakes = tp->total_flakes;
+   return s;
+}
+
+/* the tube's flakes go to the reserve list, and the saved ones are put */
+/* together (with the tube unhooked, so nothing is counted) and put in  */
+void restore_tube(tube *tp, tube_state *s)
+{
+   int f,k,x=0,stat_m=tp->stat_m,*c;  flake *fp;
+
+   while (tp->flake_list!=NULL) remove_flake(tp->flake_list);
+   memcpy(tp->conc, s->conc, (tp->N+1)*sizeof(double));
+   reset_conc_trees(tp);
+   for (f=0; f<s->num_flakes; f++) {
+      c = s->cells+x;
+      if ((fp = recover_flake(c[0],c[1],c[2],0)) == NULL) 
+         fp = init_flake(tp->P,tp->N,c[0],c[1],c[2],0);
+      fp->flake_conc = s->flake_conc[f];
+      fp->seed_is_double_tile = c[3];  fp->seed_is_vdouble_tile = c[4];
+      for (k=0; k<c[5]; k++) change_cell(fp, c[6+3*k], c[7+3*k], c[8+3*k]);
+      x += 6+3*c[5];
+      insert_flake(fp,tp);
+      fp->flake_ID = s->flake_ID[f];
+   }
+   tp->total_flakes = s->total_flakes;
+   tp->stat_m = stat_m;  tp->flick_fp = NULL;  tp->atam_n = -1;
+   tp->big_flakes = 0;
+   for (fp=tp->flake_list; fp!=NULL; fp=fp->next_flake) 
+      if (tp->big_size>0 && fp->tiles >= tp->big_size) tp->big_flakes++;
+}
+
+tube_state *copy_tube_state(tube_state *s, int N)
+{
+   tube_state *c = (tube_state *)calloc_err(1,sizeof(tube_state));
+   *c = *s;
+   c->conc = (double *)calloc_err(sizeof(double),N+1);
+   memcpy(c->conc, s->conc, (N+1)*sizeof(double));
+   c->cells = (int *)calloc_err(sizeof(int),MAX(1,s->len));
+   memcpy(c->cells, s->cells, s->len*sizeof(int));
+   c->flake_conc = (double *)calloc_err(sizeof(double),MAX(1,s->num_flakes));
+   memcpy(c->flake_conc, s->flake_conc, s->num_flakes*sizeof(double));
+   c->flake_ID = (int *)calloc_err(sizeof(int),MAX(1,s->num_flakes));
+   memcpy(c->flake_ID, s->flake_ID, s->num_flakes*sizeof(int));
+   return c;
+}
+
+void free_tube_state(tube_state *s)
+{
+   free(s->conc); free(s->cells); free(s->flake_conc); free(s->flake_ID); free(s);
+}
+
+/* [threads] task(wk[w],w,arg) for each of the nwk worker tubes, on up */
+/* to 'threads' threads, each taking the next worker not yet run.  what */
+/* a worker does, and the random numbers it does it with, are its own, */
+/* so the outcome doesn't depend on how many threads there are.         */
+typedef struct {
+   tube **wk;  int nwk, next;  pthread_mutex_t lock;
+   void (*task)(tube *, int, void *);  void *arg;
+} worker_pool;
+
+static void *run_worker(void *p)
+{
+   worker_pool *wp = (worker_pool *)p;  int w;
+   for (;;) {
+      pthread_mutex_lock(&wp->lock);  w = wp->next++;  pthread_mutex_unlock(&wp->lock);
+      if (w >= wp->nwk) break;
+      wp->task(wp->wk[w],w,wp->arg);
+   }
+   free_pools();
+   return NULL;
+}
+
+static void run_workers(tube **wk, int nwk, int threads, 
+      void (*task)(tube *, int, void *), void *arg)
+{
+   worker_pool wp;  pthread_t *pool;  int i, nt=MIN(threads,nwk);
+   if (nt <= 1) {
+      for (i=0; i<nwk; i++) task(wk[i],i,arg);
+      return;
+   }
+   wp.wk = wk;  wp.nwk = nwk;  wp.next = 0;  wp.task = task;  wp.arg = arg;
+   pthread_mutex_init(&wp.lock,NULL);
+   pool = (pthread_t *)calloc_err(sizeof(pthread_t),nt);
+   for (i=0; i<nt; i++) pthread_create(&pool[i],NULL,run_worker,&wp);
+   for (i=0; i<nt; i++) pthread_join(pool[i],NULL);
+   pthread_mutex_destroy(&wp.lock);
+   free(pool);
+}
+
+/* [ffs] the trials from one interface: trial tr is run by worker tr % */
+/* nwk, with the random numbers rng[tr], from a state in from[] it     */
+/* picks, and what it got to (or NULL) goes in got[tr]                 */
+#define FFS_EVENTS (1ULL<<40)
+typedef struct {
+   tube_state **from, **got;  xgrow_rng *rng;  int nfrom, trials, nwk, target;
+} ffs_job;
+
+static void ffs_trials(tube *tp, int w, void *arg)
+{
+   ffs_job *job = (ffs_job *)arg;  int tr, k;
+   for (tr=w; tr<job->trials; tr+=job->nwk) {
+      tp->rng = job->rng[tr];
+      k = rng_int(&tp->rng,job->nfrom);
+      restore_tube(tp,job->from[k]);
+      tp->largest_flake_size = job->from[k]->size;
+      do simulate(tp,FFS_EVENTS,0,0,0,job->target,-1,0);
+      while (tp->big_flakes > 0 && tp->largest_flake_size < job->target);
+      job->got[tr] = NULL;
+      if (tp->largest_flake_size >= job->target) {
+         job->got[tr] = save_tube(tp);
+         job->got[tr]->parent = k;
+      }
+   }
+}
+
+/* [checkpoint] the whole state of a tube as a binary image: everything  */
+/* simulate() keeps or reads, down to the order of the cell classes and  */
+/* the signature ids, so that a run restarted from it takes the very     */
+/* same events.  what comes from the tile set and the options isn't in   */
+/* it, so it can only be read back into a tube made the same way; the    */
+/* header checks that as far as it can.  one routine goes both ways, so  */
+/* that writing and reading can't drift apart.  returns 1, or 0 if the  */
+/* file ran short, or -1 (having said so) if its header doesn't fit.     */
+#define CHECKPOINT_VERSION 2
+#define CK(x)    do { if (w) fwrite(&(x),sizeof(x),1,f); \
+                      else ok = ok && fread(&(x),sizeof(x),1,f)==1; } while (0)
+#define CKN(p,n) do { if (w) fwrite((p),sizeof(*(p)),(n),f); \
+                      else ok = ok && fread((p),sizeof(*(p)),(n),f)==(size_t)(n); } while (0)
+
+static int checkpoint_lists(FILE *f, int w, cell_list **lists, int *have)
+{
+   int ok=1, s, n=*have;  cell_list *cl;
+   CK(n);
+   if (!ok) return 0;
+   if (!w) cell_lists_reserve(lists, have, n);
+   for (s=0; s<n && ok; s++) {
+      cl = &(*lists)[s];
+      CK(cl->len);  CK(cl->count);
+      if (!w && ok) {
+         cl->cap = cl->len;
+         cl->cells = (int *)malloc(sizeof(int)*MAX(1,cl->len));
+      }
+      if (ok) CKN(cl->cells, cl->len);
+   }
+   return ok;
+}
 
+static int checkpoint_io(tube *tp, FILE *f, int w)
+{
+   char magic[8] = "xgrowck";
+   int ok=1, version=CHECKPOINT_VERSION, trep=sizeof(Trep), page=sizeof(flake_page);
+   int N=tp->N, C=tp->num_bond_classes, P=tp->P, present=present_list_len, lazy=tp->off_lazy;
+   int i, k, r, s, B, size, has, len, nsigs=tp->num_sigs, nflakes=tp->num_flakes, slots=tp->flake_slots;
+   int key[4], flick=-1;
+   unsigned long t;  flake *fp=NULL, *last=NULL;  flake_page *pg;
+
+   CKN(magic,8);  CK(version);  CK(trep);  CK(page);
+   CK(N);  CK(C);  CK(P);  CK(present);  CK(lazy);
+   if (!ok || magic[7]!=0 || strcmp(magic,"xgrowck") || version!=CHECKPOINT_VERSION ||
+         trep!=sizeof(Trep) || page!=sizeof(flake_page)) {
+      fprintf(stderr,"checkpoint: not a checkpoint, or not one this xgrow can read\n");
+      return -1;
+   }
+   if (N!=tp->N || C!=tp->num_bond_classes || P<tp->P || P>MAX(tp->P,tp->max_P) ||
+         present!=present_list_len || lazy!=tp->off_lazy) {
+      fprintf(stderr,"checkpoint: made with another tile set or other options\n");
+      return -1;
+   }
+   if (!w) while (tp->P < P) expand_tube(tp);
+   size = (1<<P);
+
+   /* the tube's clock, stats and conditions */
+   CK(tp->t);  CK(tp->events);  CK(tp->ewrapped);  CK(tp->rng);
+   CK(tp->stat_a);  CK(tp->stat_d);  CK(tp->stat_h);  CK(tp->stat_f);  CK(tp->stat_m);
+   CK(tp->Gse);  CK(tp->Gmc);  CK(tp->initial_Gfc);  CK(tp->off_Gse);
+   CK(tp->updates);  CK(tp->next_update_t);  CK(tp->currentC);
+   CK(tp->default_seed_i);  CK(tp->default_seed_j);
+   CK(tp->total_flakes);  CK(tp->largest_flake);  CK(tp->largest_flake_size);  CK(tp->big_flakes);
+   CK(tp->frozen_rate);  CK(tp->frozen_missed);  CK(tp->flickers);  CK(tp->slides);
+   CK(tp->all_present);  CK(tp->untiltilescount);
+   CK(tp->validate_next);  CK(tp->validate_runs);  CK(tp->validate_bad);
+   CK(tp->atam_events);  CK(tp->atam_nondet);
+   CK(tp->atam_nd_flake);  CK(tp->atam_nd_i);  CK(tp->atam_nd_j);  CK(tp->atam_nd_n);
+   CKN(tp->conc,N+1);  CKN(tp->Gse_bond,C*C);
+
+   /* off-rate classes [off_lazy], by number */
+   CK(tp->num_off_classes);
+   if (!ok) return 0;
+   if (!w) {
+      tp->off_cap = 16;  while (tp->off_cap < tp->num_off_classes) tp->off_cap *= 2;
+      tp->off_units = (double *)realloc(tp->off_units, sizeof(double)*tp->off_cap);
+      tp->off_rate = (double *)realloc(tp->off_rate, sizeof(double)*tp->off_cap);
+      tp->off_w = (double *)realloc(tp->off_w, sizeof(double)*(tp->off_cap+1));
+      free(tp->off_hash);
+      tp->off_hash = (int *)calloc_err(sizeof(int), 2*tp->off_cap);
+   }
+   CKN(tp->off_units,tp->num_off_classes);  CKN(tp->off_rate,tp->num_off_classes);
+   if (!w) for (s=0; s<tp->num_off_classes; s++) off_hash_insert(tp,s);
+
+   /* site signatures, by id; their tiles[] follow from Gse_bond */
+   CK(nsigs);
+   if (!ok) return 0;
+   if (!w) {
+      for (s=0; s<tp->num_sigs; s++) free(tp->sigs[s].tiles);
+      tp->num_sigs = 0;  memset(tp->sig_table, 0, sizeof(int)*tp->sig_size);
+      for (i=0; i<=N; i++) tp->num_sigs_with[i] = 0;
+   }
+   for (s=0; s<nsigs && ok; s++) {
+      if (w) { key[0]=tp->sigs[s].nN; key[1]=tp->sigs[s].nE; key[2]=tp->sigs[s].nS; key[3]=tp->sigs[s].nW; }
+      CKN(key,4);
+      if (!w && ok) ok = (sig_lookup(tp,key[0],key[1],key[2],key[3]) == s);
+   }
+
+   /* the flake registry and its sum tree */
+   CK(nflakes);  CK(slots);
+   if (!ok || slots<1 || (slots & (slots-1)) || nflakes>slots) return 0;
+   if (!w) {
+      free(tp->flakes); free(tp->flake_rates);
+      tp->flakes = (flake **)calloc_err(sizeof(flake *),slots);
+      tp->flake_rates = (double *)calloc_err(sizeof(double),2*slots);
+      tp->flake_slots = slots;  tp->num_flakes = nflakes;  tp->flake_list = NULL;
+   }
+   CKN(tp->flake_rates,2*slots);
+
+   /* the flakes, in list order: cells, pyramid, pages and classes as is */
+   if (w) fp = tp->flake_list;
+   for (k=0; k<nflakes && ok; k++) {
+      if (!w) {
+         fp = (flake *)calloc_err(1,sizeof(flake));
+         fp->N = N;  flake_block_init(fp,P);  fp->tube = tp;
+         fp->prev_flake = last;  fp->next_flake = NULL;
+         if (last) last->next_flake = fp; else tp->flake_list = fp;
+      }
+      CK(fp->flake_index);  CK(fp->flake_ID);  CK(fp->events);
+      CK(fp->seed_i);  CK(fp->seed_j);  CK(fp->seed_n);
+      CK(fp->seed_is_double_tile);  CK(fp->seed_is_vdouble_tile);
+      CK(fp->tiles);  CK(fp->mismatches);  CK(fp->perimeter);
+      CK(fp->G);  CK(fp->dG_bonds);  CK(fp->flake_conc);  CK(fp->frozen_rate);
+      CK(fp->box_i0);  CK(fp->box_i1);  CK(fp->box_j0);  CK(fp->box_j1);
+      CK(fp->live_i0);  CK(fp->live_i1);  CK(fp->live_j0);  CK(fp->live_j1);
+      CK(fp->origin_i);  CK(fp->origin_j);
+      if (!ok || fp->flake_index<0 || fp->flake_index>=nflakes) { ok=0; break; }
+      if (!w) tp->flakes[fp->flake_index] = fp;
+      B = fp->page_bits;
+      CKN(fp->is_present,present);  CKN(fp->tile_sites,N+1);  CKN(fp->row_tiles,2*size);
+      CKN(fp->rate,RateLevel(P-B+1));
+      for (r=0; r<2+size && ok; r++) {
+         has = (fp->cell[r]!=fp->zero_row);  CK(has);
+         if (!w && has) row_touch(fp,r);
+         if (has) CKN(fp->cell[r],2+size);
+      }
+      for (t=0; t < (1UL<<(2*(P-B))) && ok; t++) {
+         has = (fp->page[t]!=NULL);  CK(has);
+         if (!has) continue;
+         pg = w ? fp->page[t] : page_get(fp,t);
+         CKN(pg->rate,PageLevel(PAGE_BITS+1));  CKN(pg->cell_class,PAGE_CELLS);
+         CKN(pg->cell_slot,PAGE_CELLS);  CK(pg->used);
+      }
+      /* the rates set aside by freeze=, if any [freeze] */
+      has = (fp->frozen!=NULL);  CK(has);
+      if (!w && has) frozen_table(fp);
+      for (t=0; fp->frozen && t < (1UL<<(2*(P-B))) && ok; t++) {
+         has = (fp->frozen[t]!=NULL);  CK(has);
+         if (!has) continue;
+         if (!w) fp->frozen[t] = (frozen_page *)calloc_err(1, sizeof(frozen_page));
+         CKN(fp->frozen[t]->rate,PAGE_CELLS);  CK(fp->frozen[t]->n);
+      }
+      ok = ok && checkpoint_lists(f,w,&fp->off,&fp->off_n);
+      ok = ok && checkpoint_lists(f,w,&fp->sites,&fp->sites_n);
+      if (w) fp = fp->next_flake; else last = fp;
+   }
+   if (!ok) return 0;
+
+   /* each tile's list of flakes, by registry slot and in list order;   */
+   /* the counts in its sum tree are the flakes' tile_sites[]           */
+   for (i=1; i<=N && ok; i++) {
+      tile_flakes *tf = &tp->tile_fl[i];
+      len = tf->len;  CK(len);
+      if (!ok || len<0 || len>nflakes) return 0;
+      if (!w) {
+         while (tf->cap < len) grow_tile_flakes(tf);
+         memset(tf->sites, 0, sizeof(int)*2*tf->cap);  tf->len = len;
+      }
+      CKN(tf->slot,len);
+      for (k=0; !w && ok && k<len; k++) {
+         if (tf->slot[k]<0 || tf->slot[k]>=nflakes) return 0;
+         fp = tp->flakes[tf->slot[k]];
+         fp->tile_at[i] = k+1;  tf->sites[tf->cap+k] = fp->tile_sites[i];
+      }
+      if (!w) for (k=tf->cap-1; k>=1; k--) tf->sites[k] = tf->sites[2*k] + tf->sites[2*k+1];
+   }
+   if (!ok) return 0;
+   if (w && tp->flick_fp!=NULL) flick = tp->flick_fp->flake_index;
+   CK(flick);  CK(tp->flick_i);  CK(tp->flick_j);
+   if (!w) tp->flick_fp = (ok && flick>=0 && flick<nflakes) ? tp->flakes[flick] : NULL;
+
+   /* the aTAM frontier [atam], with flakes by registry slot */
+   CK(tp->atam_n);  CK(tp->atam_head);  CK(tp->atam_cap);
+   if (!ok || tp->atam_n > tp->atam_cap) return 0;
+   if (!w && tp->atam_n>0)
+      tp->atam_front = (atam_site *)realloc(tp->atam_front, sizeof(atam_site)*tp->atam_cap);
+   for (i=0; i<tp->atam_n && ok; i++) {
+      if (w) { key[0]=tp->atam_front[i].fp->flake_index; key[1]=tp->atam_front[i].i; key[2]=tp->atam_front[i].j; }
+      CKN(key,3);
+      if (!w && ok) {
+         if (key[0]<0 || key[0]>=nflakes) { ok=0; break; }
+         tp->atam_front[i].fp = tp->flakes[key[0]];
+         tp->atam_front[i].i = key[1];  tp->atam_front[i].j = key[2];
+      }
+   }
+   if (!w && ok) reset_conc_trees(tp);
+   return ok;
+} // checkpoint_io()
+#undef CK
+#undef CKN
+
+/* write a checkpoint to fn.tmp and rename it to fn, so that fn is     */
+/* always a whole checkpoint, the last one or this one.  returns 0 if  */
+/* it couldn't be written.                                             */
+int write_checkpoint(tube *tp, char *fn)
+{
+   char *tmp = (char *)malloc(strlen(fn)+5);  FILE *f;  int ok;
+
+   sprintf(tmp,"%s.tmp",fn);
+   if ((f = fopen(tmp,"wb")) == NULL) {
+      fprintf(stderr,"checkpoint: can't write %s\n",tmp);  free(tmp);
+      return 0;
+   }
+   ok = (checkpoint_io(tp,f,1) > 0);
+   ok = ok && fflush(f)==0 && !ferror(f) && fsync(fileno(f))==0;
+   ok = (fclose(f)==0) && ok;
+   ok = ok && rename(tmp,fn)==0;
+   if (!ok) { fprintf(stderr,"checkpoint: couldn't write %s\n",fn);  remove(tmp); }
+   free(tmp);
+   return ok;
+}
+
+/* put the tube back as it was checkpointed.  it must have been made   */
+/* from the same tile set and options; its own flakes are dropped      */
+/* first.  returns 0, having said why, if that didn't work.            */
+int read_checkpoint(tube *tp, char *fn)
+{
+   FILE *f;  int ok;
+
+   if ((f = fopen(fn,"rb")) == NULL) {
+      fprintf(stderr,"checkpoint: can't read %s\n",fn);
+      return 0;
+   }
+   while (tp->flake_list!=NULL) remove_flake(tp->flake_list);
+   ok = checkpoint_io(tp,f,0);
+   if (ok>0 && fgetc(f)!=EOF) ok = 0;
+   fclose(f);
+   if (ok==0) fprintf(stderr,"checkpoint: %s is damaged\n",fn);
+   return (ok > 0);
+}
+
+/* [ffs] forward flux sampling of nucleation in a tinybox, on the size  */
+/* of the largest flake: simulate stops when big_flakes goes to or from */
+/* 0, or at fsmax.  a basin run of t_basin seconds gives the flux       */
+/* of crossings of ifc[0] from below, and saves the state just after    */
+/* each; then, one interface at a time, 'trials' runs start from saved  */
+/* states chosen at random and go until the largest flake reaches the   */
+/* next interface (that state is saved) or all flakes are back below    */
+/* ifc[0].  a basin run that gets all the way to ifc[n_ifc-1] starts    */
+/* over from where it began.  the rate is the flux times the fractions  */
+/* that made it; its error is estimated as if the crossings were        */
+/* Poisson and the trials independent.  the flakes along each path that */
+/* made it to the last interface are written to out, if not NULL.      */
+/* the basin run is wk[0]'s, and the trials are shared out among the   */
+/* nwk worker tubes wk[], run on up to 'threads' threads; they restore */
+/* from the saved states, which stay as they are meanwhile.  each      */
+/* trial has its own random numbers, split off wk[0]'s in trial order, */
+/* so the estimate is the same however many workers there are.        */
+void ffs_simulate(tube **wk, int nwk, int threads, int n_ifc, int *ifc, int trials, 
+      double t_basin, FILE *out)
+{
+   tube *tp=wk[0];  tube_state *start, ***saved;  int *nsaved, i, k, tr, below;
+   double t, t_A=0, rate, err2;  ffs_job job;  xgrow_rng keep;
+
+   saved = (tube_state ***)calloc_err(sizeof(tube_state **),n_ifc);
+   nsaved = (int *)calloc_err(sizeof(int),n_ifc);
+   saved[0] = (tube_state **)calloc_err(sizeof(tube_state *),16);
+
+   tp->big_size = ifc[0];
+   start = save_tube(tp);
+   restore_tube(tp,start);  /* to count big_flakes */
+   tp->largest_flake_size = largest_flake_now(tp);
+   below = (tp->big_flakes == 0);
+   while (t_A < t_basin) {
+      t = tp->t;
+      simulate(tp,FFS_EVENTS,t+t_basin-t_A,0,0,ifc[n_ifc-1],-1,0);
+      t_A += tp->t - t;
+      if (below && tp->big_flakes > 0) {
+         if ((nsaved[0] & (nsaved[0]-1)) == 0 && nsaved[0] >= 16)
+            saved[0] = (tube_state **)realloc(saved[0],2*nsaved[0]*sizeof(tube_state *));
+         saved[0][nsaved[0]++] = save_tube(tp);
+      }
+      if (tp->largest_flake_size >= ifc[n_ifc-1]) {
+         restore_tube(tp,start);  tp->largest_flake_size = largest_flake_now(tp);
+      }
+      below = (tp->big_flakes == 0);
+      if (below) tp->largest_flake_size = ifc[0]-1;
+   }
+   free_tube_state(start);
+   printf("ffs: flux through size %d: %g /s (%d crossings in %g s)\n",
+         ifc[0], nsaved[0]/t_A, nsaved[0], t_A);
+   if (nsaved[0]==0) {
+      printf("ffs: no crossings; try a longer ffs_time= or a lower first interface\n");
+      n_ifc = 1;
+   }
+   rate = nsaved[0]/t_A;  err2 = 1.0/MAX(1,nsaved[0]);
+
+   job.rng = (xgrow_rng *)calloc_err(sizeof(xgrow_rng),trials);
+   for (k=1; k<nwk; k++) wk[k]->big_size = ifc[0];
+   for (i=0; i+1<n_ifc && nsaved[i]>0; i++) {
+      saved[i+1] = (tube_state **)calloc_err(sizeof(tube_state *),trials);
+      for (tr=0; tr<trials; tr++) rng_split(&tp->rng,&job.rng[tr]);
+      keep = tp->rng;
+      job.from = saved[i];  job.nfrom = nsaved[i];  job.got = saved[i+1];
+      job.trials = trials;  job.nwk = nwk;  job.target = ifc[i+1];
+      run_workers(wk,nwk,threads,ffs_trials,&job);
+      tp->rng = keep;
+      for (tr=0; tr<trials; tr++)   /* those that made it, in trial order */
+         if (saved[i+1][tr]!=NULL) saved[i+1][nsaved[i+1]++] = saved[i+1][tr];
+      printf("ffs: P(%d -> %d) = %d/%d = %g\n", ifc[i], ifc[i+1],
+            nsaved[i+1], trials, (double)nsaved[i+1]/trials);
+      rate *= (double)nsaved[i+1]/trials;
+      if (nsaved[i+1]>0) err2 += (trials-nsaved[i+1])/((double)nsaved[i+1]*trials);
+   }
+   if (i+1==n_ifc && nsaved[i]>0) {
+      printf("ffs: nucleation rate to size %d: %g +- %g /s in the box (%g /L/s)\n",
+            ifc[n_ifc-1], rate, rate*sqrt(err2), rate/tp->tinybox);
+      /* each path, from the last interface back to the first */
+      for (tr=0; out!=NULL && tr<nsaved[n_ifc-1]; tr++) {
+         char mode[32];  flake *fp, *big;
+         sprintf(mode,"ffs_path{%d}",tr+1);
+         for (i=n_ifc-1, k=tr; i>=0; k=saved[i][k]->parent, i--) {
+            int i0,i1,j0,j1;
+            restore_tube(tp,saved[i][k]);
+            for (big=fp=tp->flake_list; fp!=NULL; fp=fp->next_flake) 
+               if (fp->tiles > big->tiles) big=fp;
+            flake_box(big,0,&i0,&i1,&j0,&j1);
+            write_cells(out,mode,i+1,big,i0,i1,j0,j1);
+         }
+      }
+   } else if (nsaved[0]>0)
+      printf("ffs: no trial reached size %d, so no rate\n", ifc[i]);
+
+   for (i=0; i<n_ifc; i++) {
+      for (k=0; k<nsaved[i]; k++) free_tube_state(saved[i][k]);
+      free(saved[i]);
+   }
+   free(saved); free(nsaved); free(job.rng);
+   for (k=0; k<nwk; k++) wk[k]->big_size = wk[k]->big_flakes = 0;
+}
+
+/* [split] a weighted-ensemble replica: a saved tube and its counters */
+typedef struct {
+   tube_state *s;  double w, t;
+   evint events, stat_a, stat_d, stat_h, stat_f;  int stat_m;
+} replica;
+
+static void put_replica(tube *tp, replica *r)
+{
+   restore_tube(tp,r->s);
+   tp->t = r->t;  tp->events = r->events;  tp->stat_m = r->stat_m;
+   tp->stat_a = r->stat_a;  tp->stat_d = r->stat_d;
+   tp->stat_h = r->stat_h;  tp->stat_f = r->stat_f;
+}
+
+static void take_replica(tube *tp, replica *r)
+{
+   if (r->s!=NULL) free_tube_state(r->s);
+   r->s = save_tube(tp);
+   r->t = tp->t;  r->events = tp->events;  r->stat_m = tp->stat_m;
+   r->stat_a = tp->stat_a;  r->stat_d = tp->stat_d;
+   r->stat_h = tp->stat_h;  r->stat_f = tp->stat_f;
+}
+
+/* [split] one round: replica i is run by worker i % nwk, with the   */
+/* random numbers rng[i]                                              */
+typedef struct {
+   replica *reps;  xgrow_rng *rng;  int n, nwk;  double t_end;
+} split_job;
+
+static void split_round(tube *tp, int w, void *arg)
+{
+   split_job *job = (split_job *)arg;  int i;
+   for (i=w; i<job->n; i+=job->nwk) {
+      put_replica(tp,&job->reps[i]);
+      tp->rng = job->rng[i];
+      simulate(tp,1ULL<<40,job->t_end,0,0,0,-1,0);
+      take_replica(tp,&job->reps[i]);
+   }
+}
+
+static int by_stat_m(const void *a, const void *b)
+{
+   return ((replica *)a)->stat_m - ((replica *)b)->stat_m;
+}
+
+/* [split] weighted-ensemble estimate of how often mismatches get built */
+/* in.  per_bin replicas of the tube, each carrying a weight, are run   */
+/* dt_seg seconds at a time until tmax; after each round they are       */
+/* binned by stat_m, and each bin is brought back to per_bin replicas   */
+/* by splitting its heaviest replica in two (half the weight each) or   */
+/* merging its two lightest (one survives, with probability in          */
+/* proportion to its weight, carrying both weights).  neither changes   */
+/* the expected weight anywhere, so weighted averages stay unbiased,    */
+/* while the rare replicas that carry a mismatch get as many copies as  */
+/* the common ones.  the tube wk[0] is left as the heaviest replica.    */
+/* each round's replicas are shared out among the nwk worker tubes wk[] */
+/* and run on up to 'threads' threads, each replica with random numbers */
+/* split off wk[0]'s in replica order, so the estimate is the same      */
+/* however many workers there are; binning, merging and splitting are  */
+/* done between rounds, with wk[0]'s random numbers.                    */
+void split_simulate(tube **wk, int nwk, int threads, int per_bin, double dt_seg, double tmax)
+{
+   tube *tp=wk[0];  replica *reps, *out;  int n=per_bin, a, b, c, i, k, m, lo, lo2;
+   double t_next, wm=0, wa=0, w;  split_job job;  xgrow_rng keep;
+
+   reps = (replica *)calloc_err(sizeof(replica),n);
+   for (i=0; i<n; i++) { reps[i].w = 1.0/per_bin;  take_replica(tp,&reps[i]); }
+   for (t_next=tp->t+dt_seg; ; t_next+=dt_seg) {
+      job.rng = (xgrow_rng *)calloc_err(sizeof(xgrow_rng),n);
+      for (i=0; i<n; i++) rng_split(&tp->rng,&job.rng[i]);
+      keep = tp->rng;
+      job.reps = reps;  job.n = n;  job.nwk = nwk;  job.t_end = MIN(t_next,tmax);
+      run_workers(wk,nwk,threads,split_round,&job);
+      tp->rng = keep;  free(job.rng);
+      if (t_next >= tmax) break;
+      qsort(reps,n,sizeof(replica),by_stat_m);
+      out = (replica *)calloc_err(sizeof(replica),n*per_bin);
+      for (a=0, m=0; a<n; a=b) {
+         for (b=a+1; b<n && reps[b].stat_m==reps[a].stat_m; b++);
+         for (c=m, i=a; i<b; i++) out[m++] = reps[i];
+         while (m-c > per_bin) {  /* merge the two lightest */
+            lo=c; lo2=c+1;
+            if (out[lo2].w < out[lo].w) { lo=c+1; lo2=c; }
+            for (i=c+2; i<m; i++) 
+               if (out[i].w < out[lo].w) { lo2=lo; lo=i; }
+               else if (out[i].w < out[lo2].w) lo2=i;
+            w = out[lo].w + out[lo2].w;
+            if (rng_uniform(&tp->rng)*w < out[lo].w) { k=lo; lo=lo2; lo2=k; }
+            out[lo2].w = w;  free_tube_state(out[lo].s);  out[lo] = out[--m];
+         }
+         while (m-c < per_bin) {  /* split the heaviest */
+            for (k=c, i=c+1; i<m; i++) if (out[i].w > out[k].w) k=i;
+            out[m] = out[k];  out[m].s = copy_tube_state(out[k].s,tp->N);
+            out[k].w /= 2;  out[m++].w = out[k].w;
+         }
+      }
+      free(reps);  reps = out;  n = m;
+   }
+
+   qsort(reps,n,sizeof(replica),by_stat_m);
+   for (a=0, k=0; a<n; a=b) {
+      for (w=0, b=a; b<n && reps[b].stat_m==reps[a].stat_m; b++) w += reps[b].w;
+      printf("split: %d mismatches: weight %g (%d replicas)\n", reps[a].stat_m, w, b-a);
+   }
+   for (i=0; i<n; i++) {
+      m = reps[i].stat_m;  wm += reps[i].w*m;
+      wa += reps[i].w*(double)(reps[i].stat_a-reps[i].stat_d);
+      if (reps[i].w > reps[k].w) k=i;
+   }
+   printf("split: %d replicas at t=%g: %g mismatches per tile (mean %g in %g tiles)\n",
+         n, reps[0].t, wa>0 ? wm/wa : 0, wm, wa);
+   put_replica(tp,&reps[k]);
+   for (i=0; i<n; i++) free_tube_state(reps[i].s);
+   free(reps);
+}
 
 /* for testing analytic solution to 2-tile 1D polymerization */
 /* simulates until some limit is reached (all must be given) */
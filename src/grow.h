@@ -25,6 +25,31 @@
 double drand48(); long lrand48(); 
 double exp(); double log();
 
+/* each tube draws from its own xoshiro256** generator, so that tubes   */
+/* are independent and a run is reproducible from its seed alone.  the  */
+/* state is plain data: copy it to save or restore it.                  */
+typedef struct xgrow_rng_struct {
+   unsigned long long s[4];
+} xgrow_rng;
+
+static inline unsigned long long rng_next(xgrow_rng *rng)
+{
+   unsigned long long *s = rng->s, x = s[1]*5, t = s[1]<<17;
+   x = ((x<<7) | (x>>57)) * 9;
+   s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+   s[2] ^= t;    s[3] = (s[3]<<45) | (s[3]>>19);
+   return x;
+}
+
+/* uniform on [0,1), with 53 random bits, like drand48() */
+static inline double rng_uniform(xgrow_rng *rng)
+{
+   return (rng_next(rng)>>11) * (1.0/9007199254740992.0);
+}
+
+/* uniform integer 0...n-1, like random()%n */
+#define rng_int(rng,n) ((long)(rng_uniform(rng)*(n)))
+
 #ifndef MIN
 #define MIN(a,b) ((a)<(b)?(a):(b))
 #endif
@@ -45,57 +70,110 @@ double exp(); double log();
    Cell(-1,j), Cell(size,j), Cell(i,-1), Cell(i,size)
    */
 
+/* the rate pyramid is one flat array.  level p (0 <= p <= P) starts at  */
+/* RateLevel(p), and within a level node i,j sits at its Morton (Z-order) */
+/* index, so the four children of any node are adjacent and 4-aligned:   */
+/* children of (p,i,j) are (p+1,2i+di,2j+dj) at 4*Morton(i,j)+2*di+dj.   */
+/* index 3 is the root; indices 0..2 are padding.                        */
+#define RateLevel(p) (((1UL<<(2*(p)))+8)/3)
+#define Morton(i,j)  ((spread_bits(i)<<1)|spread_bits(j))
+#define Rate(p,i,j)  rate[RateLevel(p)+Morton(i,j)]
+
+/* only the top P-B levels of the pyramid (B = flake->page_bits, which   */
+/* is PAGE_BITS unless the field is smaller) are kept in rate[]; below   */
+/* each node t of level P-B hangs a page, holding the node's subtree and */
+/* the class and slot of its 4^B cells, that exists only while one of    */
+/* them has a rate or a class.  so Rate(p,i,j) is valid for p <= P-B.    */
+/* in a page, relative level l (1 <= l <= B) starts at PageLevel(l), and */
+/* is indexed by the low 2l bits of the Morton index.                    */
+#define PAGE_BITS 4
+#define PAGE_CELLS (1<<(2*PAGE_BITS))
+#define PageLevel(l) (((1UL<<(2*(l)))-4)/3)
+typedef struct flake_page_struct {
+   double rate[PageLevel(PAGE_BITS+1)];
+   int cell_class[PAGE_CELLS],  /* 0 if in no class, s+1 if in off[s],     */
+       cell_slot[PAGE_CELLS];   /* -(id+1) if in sites[id]; and 1 + its    */
+   /* position in that class's cells[], or 0          */
+   int used;                    /* # of its cells that have a class        */
+   struct flake_page_struct *next;  /* while in the free pool              */
+} flake_page;
+
+/* the off-rates freeze= has set aside in the cells of one page.  these  */
+/* are kept apart from the pages, in a table the flake only makes once   */
+/* it sets one aside, so runs without freeze= don't carry them.          */
+typedef struct frozen_page_struct {
+   float rate[PAGE_CELLS];      /* off-rate set aside for each cell, if it */
+   int n;                       /* is below tube->freeze; # of those cells */
+} frozen_page;
+
+static inline unsigned long spread_bits(unsigned long x) 
+{  /* 0...0abcd -> 0a0b0c0d, for x < 2^16 */
+   x = (x|(x<<8)) & 0x00ff00ffUL;  x = (x|(x<<4)) & 0x0f0f0f0fUL;
+   x = (x|(x<<2)) & 0x33333333UL;  x = (x|(x<<1)) & 0x55555555UL;
+   return x;
+}
+
+/* a cell left behind by a moving window: no events, never changes */
+#define Frozen(fp,i,j) ((i)<(fp)->live_i0 || (i)>(fp)->live_i1 || \
+      (j)<(fp)->live_j0 || (j)>(fp)->live_j1)
+
 /* for times when it's inconvenience to know if i,j are within bounds */
-#define CellM(i,j) cell[periodic?((i+size)%size):MAX(0,MIN((i)+1,size+1))][periodic?((j+size)%size):MAX(0,MIN((j)+1,size+1))]
+#define CellM(i,j) cell[periodic?(((i)+size)%size+1):MAX(0,MIN((i)+1,size+1))][periodic?(((j)+size)%size+1):MAX(0,MIN((j)+1,size+1))]
+
+/* bond energy between tile types, looked up through each tile's edge   */
+/* bond classes (see tube->bond_class).  these are lvalues.             */
+#define BondClass(tp,n,d) ((tp)->bond_class[4*(n)+(d)])
+#define Gse_EW(tp,n1,n2) ((tp)->Gse_bond[BondClass(tp,n1,3)*(tp)->num_bond_classes + BondClass(tp,n2,1)])
+#define Gse_NS(tp,n1,n2) ((tp)->Gse_bond[BondClass(tp,n1,2)*(tp)->num_bond_classes + BondClass(tp,n2,0)])
 
 /* macro definition of summed sticky end bond energy                    */
 /* computes energy IF Cell(i,j) were n, given its current neighbors     */
 /* assumes "fp" arg is a simple variable, but others can be expressions */
 /* note that n != 0  and assumes 0 <= i,j < (1<<fp->P)                  */
 #define Gse(fp,i,j,n) (                                \
-      fp->tube->Gse_EW[ n ] [ fp->Cell(i,(j)-1) ] +  \
-      fp->tube->Gse_EW[ fp->Cell(i,(j)+1) ] [ n ] +  \
-      fp->tube->Gse_NS[ n ] [ fp->Cell((i)+1,j) ] +  \
-      fp->tube->Gse_NS[ fp->Cell((i)-1,j) ] [ n ] )
+      Gse_EW(fp->tube, n, fp->Cell(i,(j)-1)) +  \
+      Gse_EW(fp->tube, fp->Cell(i,(j)+1), n) +  \
+      Gse_NS(fp->tube, n, fp->Cell((i)+1,j)) +  \
+      Gse_NS(fp->tube, fp->Cell((i)-1,j), n) )
 
 #define Gse_double(fp,i,j,n) (                                \
-      fp->tube->Gse_EW[ n ] [ fp->Cell(i,(j)-1) ] +  \
-      fp->tube->Gse_NS[ n ] [ fp->Cell((i)+1,j) ] +  \
-      fp->tube->Gse_NS[ fp->Cell((i)-1,j) ] [ n ] + \
-      fp->tube->Gse_EW[ fp->CellM(i,(j)+2) ] [ fp->Cell(i,(j)+1) ] +  \
-      fp->tube->Gse_NS[ fp->Cell(i,(j)+1) ] [ fp->Cell((i)+1,(j)+1) ] +  \
-      fp->tube->Gse_NS[ fp->Cell((i)-1,(j)+1) ] [ fp->Cell(i,(j)+1) ] ) /* FIXME: is this right!? */
+      Gse_EW(fp->tube, n, fp->Cell(i,(j)-1)) +  \
+      Gse_NS(fp->tube, n, fp->Cell((i)+1,j)) +  \
+      Gse_NS(fp->tube, fp->Cell((i)-1,j), n) + \
+      Gse_EW(fp->tube, fp->CellM(i,(j)+2), fp->Cell(i,(j)+1)) +  \
+      Gse_NS(fp->tube, fp->Cell(i,(j)+1), fp->Cell((i)+1,(j)+1)) +  \
+      Gse_NS(fp->tube, fp->Cell((i)-1,(j)+1), fp->Cell(i,(j)+1)) ) /* FIXME: is this right!? */
 
 #define Gse_vdouble(fp,i,j,n) (                                \
-      fp->tube->Gse_EW[ n ] [ fp->Cell(i,(j)-1) ] + \
-      fp->tube->Gse_EW[ fp->Cell(i,(j)+1) ] [ n ] + \
-      fp->tube->Gse_NS[ fp->Cell((i)-1,j) ] [ n ] + \
-      fp->tube->Gse_NS[ fp->Cell((i)+1,j) ] [ fp->CellM((i)+2,j) ] +  \
-      fp->tube->Gse_EW[ fp->Cell((i)+1,j) ] [ fp->Cell((i)+1,(j)-1) ]+  \
-      fp->tube->Gse_EW[ fp->Cell((i)+1,(j)+1) ] [ fp->Cell((i)+1,j) ] )  
+      Gse_EW(fp->tube, n, fp->Cell(i,(j)-1)) + \
+      Gse_EW(fp->tube, fp->Cell(i,(j)+1), n) + \
+      Gse_NS(fp->tube, fp->Cell((i)-1,j), n) + \
+      Gse_NS(fp->tube, fp->Cell((i)+1,j), fp->CellM((i)+2,j)) +  \
+      Gse_EW(fp->tube, fp->Cell((i)+1,j), fp->Cell((i)+1,(j)-1))+  \
+      Gse_EW(fp->tube, fp->Cell((i)+1,(j)+1), fp->Cell((i)+1,j)) )  
 
 
 
 #define Gse_double_left(fp,i,j,n) (                                \
-      fp->tube->Gse_EW[ n ] [ fp->Cell(i,(j)-1) ] +  \
-      fp->tube->Gse_NS[ n ] [ fp->Cell((i)+1,j) ] +  \
-      fp->tube->Gse_NS[ fp->Cell((i)-1,j) ] [ n ] )
+      Gse_EW(fp->tube, n, fp->Cell(i,(j)-1)) +  \
+      Gse_NS(fp->tube, n, fp->Cell((i)+1,j)) +  \
+      Gse_NS(fp->tube, fp->Cell((i)-1,j), n) )
 
 
 #define Gse_double_right(fp,i,j,n) (                                \
-      fp->tube->Gse_EW[ fp->Cell(i,(j)+1) ] [ n ] +  \
-      fp->tube->Gse_NS[ n ] [ fp->Cell((i)+1,j) ] +  \
-      fp->tube->Gse_NS[ fp->Cell((i)-1,j) ] [ n ] )
+      Gse_EW(fp->tube, fp->Cell(i,(j)+1), n) +  \
+      Gse_NS(fp->tube, n, fp->Cell((i)+1,j)) +  \
+      Gse_NS(fp->tube, fp->Cell((i)-1,j), n) )
 
 #define Gse_vdouble_up(fp,i,j,n) (                                \
-      fp->tube->Gse_EW[ n ] [ fp->Cell(i,(j)-1) ] +  \
-      fp->tube->Gse_EW[ fp->Cell(i,(j)+1) ] [ n ] +  \
-      fp->tube->Gse_NS[ fp->Cell((i)-1,j) ] [ n ] )
+      Gse_EW(fp->tube, n, fp->Cell(i,(j)-1)) +  \
+      Gse_EW(fp->tube, fp->Cell(i,(j)+1), n) +  \
+      Gse_NS(fp->tube, fp->Cell((i)-1,j), n) )
 
 #define Gse_vdouble_down(fp,i,j,n) (                                \
-      fp->tube->Gse_EW[ n ] [ fp->Cell(i,(j)-1) ] +  \
-      fp->tube->Gse_EW[ fp->Cell(i,(j)+1) ] [ n ] +  \
-      fp->tube->Gse_NS[ n ] [ fp->Cell((i)+1,j) ] )
+      Gse_EW(fp->tube, n, fp->Cell(i,(j)-1)) +  \
+      Gse_EW(fp->tube, fp->Cell(i,(j)+1), n) +  \
+      Gse_NS(fp->tube, n, fp->Cell((i)+1,j)) )
 
 
 /* definition for total sticky-end strength around a pair or a 2x2 chunk */
@@ -106,20 +184,20 @@ double exp(); double log();
 #define chunk_Gse_EW(fp,i,j,n) ( \
       Gse(fp,i,j,n) +                                                         \
       Gse(fp,i,((j)+1)%size,fp->Cell(i,((j)+1)%size)) -                       \
-      2*fp->tube->Gse_EW[ fp->Cell(i,(j)+1) ] [ n ] ) 
+      2*Gse_EW(fp->tube, fp->Cell(i,(j)+1), n) ) 
 #define chunk_Gse_NS(fp,i,j,n) ( \
       Gse(fp,i,j,n) +                                                         \
       Gse(fp,((i)+1)%size,j,fp->Cell(((i)+1)%size,j)) -                       \
-      2*fp->tube->Gse_NS[ n ] [ fp->Cell((i)+1,j) ] ) 
+      2*Gse_NS(fp->tube, n, fp->Cell((i)+1,j)) ) 
 #define chunk_Gse_2x2(fp,i,j,n) ( \
       Gse(fp,i,j,n) +                                                         \
       Gse(fp,i,((j)+1)%size,fp->Cell(i,((j)+1)%size)) +                       \
       Gse(fp,((i)+1)%size,j,fp->Cell(((i)+1)%size,j)) +                       \
       Gse(fp,((i)+1)%size,((j)+1)%size,fp->Cell(((i)+1)%size,((j)+1)%size)) - \
-      2*fp->tube->Gse_EW[ fp->Cell(i,(j)+1) ] [ fp->Cell(i,j) ] -             \
-      2*fp->tube->Gse_NS[ fp->Cell(i,j) ] [ fp->Cell((i)+1,j) ] -             \
-      2*fp->tube->Gse_EW[ fp->Cell((i)+1,(j)+1) ] [ fp->Cell((i)+1,j) ] -     \
-      2*fp->tube->Gse_NS[ fp->Cell(i,(j)+1) ] [ fp->Cell((i)+1,(j)+1) ]  ) 
+      2*Gse_EW(fp->tube, fp->Cell(i,(j)+1), fp->Cell(i,j)) -             \
+      2*Gse_NS(fp->tube, fp->Cell(i,j), fp->Cell((i)+1,j)) -             \
+      2*Gse_EW(fp->tube, fp->Cell((i)+1,(j)+1), fp->Cell((i)+1,j)) -     \
+      2*Gse_NS(fp->tube, fp->Cell(i,(j)+1), fp->Cell((i)+1,(j)+1))  ) 
 
 
 /* similar definition to count the number of sides that are mismatched   */
@@ -129,22 +207,37 @@ double exp(); double log();
 /* note that this counts twice: sum_i,j Mism(i,j) == 2ce # mism. bonds.  */
 /* however, *if* the sum is accumulated during assembly, exactly when    */
 /* the tile at i,j is being added, then it counts each mismatch ONCE.    */
-
-#define Mism(fp,i,j,n) (                                                   \
-      ((fp->tube->tileb)[n][1] != (fp->tube->tileb)[fp->Cell(i,(j)+1)][3] &&    \
-       (fp->tube->tileb)[n][1]*(fp->tube->tileb)[fp->Cell(i,(j)+1)][3] > 0 &&   \
-       (fp->tube->glue)[(fp->tube->tileb)[n][1]][(fp->tube->tileb)[fp->Cell(i,(j)+1)][3]] < min_strength) +   \
-      ((fp->tube->tileb)[n][3] != (fp->tube->tileb)[fp->Cell(i,(j)-1)][1] &&    \
-       (fp->tube->tileb)[n][3]*(fp->tube->tileb)[fp->Cell(i,(j)-1)][1] > 0 &&   \
-       (fp->tube->glue)[(fp->tube->tileb)[n][3]][(fp->tube->tileb)[fp->Cell(i,(j)-1)][1]] < min_strength) +   \
-      ((fp->tube->tileb)[n][2] != (fp->tube->tileb)[fp->Cell((i)+1,j)][0] &&    \
-       (fp->tube->tileb)[n][2]*(fp->tube->tileb)[fp->Cell((i)+1,j)][0] > 0 &&   \
-       (fp->tube->glue)[(fp->tube->tileb)[n][2]][(fp->tube->tileb)[fp->Cell((i)+1,j)][0]] < min_strength) +   \
-      ((fp->tube->tileb)[n][0] != (fp->tube->tileb)[fp->Cell((i)-1,j)][2] &&    \
-       (fp->tube->tileb)[n][0]*(fp->tube->tileb)[fp->Cell((i)-1,j)][2] > 0 && \
-       (fp->tube->glue)[(fp->tube->tileb)[n][0]][(fp->tube->tileb)[fp->Cell((i)-1,j)][2]] < min_strength) )   
-
-
+/* the per-class mismatch table is filled in by set_Gses().              */
+
+#define Mism_bond(tp,n1,d1,n2,d2) \
+   ((tp)->mism_bond[BondClass(tp,n1,d1)*(tp)->num_bond_classes + BondClass(tp,n2,d2)])
+#define Mism(fp,i,j,n) (                                    \
+      Mism_bond(fp->tube, n, 1, fp->Cell(i,(j)+1), 3) +    \
+      Mism_bond(fp->tube, n, 3, fp->Cell(i,(j)-1), 1) +    \
+      Mism_bond(fp->tube, n, 2, fp->Cell((i)+1,j), 0) +    \
+      Mism_bond(fp->tube, n, 0, fp->Cell((i)-1,j), 2) )
+
+
+
+/* a class of cells (i*2^P+j) within one flake whose events all have   */
+/* the same rate: empty sites with the same neighbour signature, or,    */
+/* with tube->off_lazy, occupied cells with the same total bond         */
+/* strength.  cells[0...len-1] are those that currently have events;    */
+/* count also includes those that don't (the seed), for bookkeeping.    */
+typedef struct cell_list_struct {
+   int len, cap, count;
+   int *cells;
+} cell_list;
+
+/* the flakes with sites where one tile type could attach: their       */
+/* registry slots, in no particular order, and a sum tree over their   */
+/* counts of those sites laid out like tube->flake_rates -- the count  */
+/* of flake slot[k] at sites[cap+k], the total at sites[1].  it grows  */
+/* only with the number of flakes that have such sites at once.        */
+typedef struct tile_flakes_struct {
+   int len, cap;
+   int *slot, *sites;
+} tile_flakes;
 
 typedef struct flake_struct {
    struct tube_struct *tube; /* contains tile set, reaction conditions,     */
@@ -152,14 +245,22 @@ typedef struct flake_struct {
    /* all flakes are the same size, 2^(tube->P)        */
    Trep N, P;  /* # non-empty tile types; 2^P active cell grid     */
 
-   Trep **cell;/* tile type at [i][j]; array of arrays             */
+   Trep **cell;/* tile type at [i][j]; row pointers, each either to */
+   /* the flake's all-zero zero_row, or, while the row */
+   /* holds a tile, to a row of its own from a pool    */
    /* note 0 <= i,j <= 2^P+1, allowing for borders     */
-   double ***rate;      /* hierarchical rates for events in non-empty cells */
-   /* rate[p][i][j] has 0 <= i,j < 2^p                 */
-   /* rate[P][i][j] = sum rates for Cell(i,j)          */
-   /* rate[p][i][j] =   sum rate[p+1][2*i+di][2*j+dj]  */
+   Trep *zero_row;      /* never written: only change_cell() writes cells   */
+   double *rate;        /* hierarchical rates for events in non-empty cells */
+   /* (on-events are kept apart, in sites[] below)     */
+   /* Rate(p,i,j) has 0 <= i,j < 2^p, p <= P-page_bits */
+   /* Rate(P,i,j) = sum rates for Cell(i,j)            */
+   /* Rate(p,i,j) =   sum Rate(p+1,2*i+di,2*j+dj)      */
    /*                 (di,dj in {0,1})                 */
-   /* rate[0][0][0] + k * sum conc[] = net event rate  */
+   /* Rate(0,0,0) = net rate of off and hydrolysis    */
+   /* events in Rate(P,...) cells                      */
+   /* rate is also the start of the flake's allocation */
+   flake_page **page;   /* [t]: page below node t of level P-page_bits, or  */
+   int page_bits;       /* NULL while it would be all zero                  */
    int ***empty;        /* hierarchical tally of number of empty cells      */
    /* adjacent to some non-empty cell.                 */
    /* for irreversible model, counts only if there is  */
@@ -167,6 +268,8 @@ typedef struct flake_struct {
    double flake_conc;   /* for depleting concentrations of monomers as they */
    /* are incorporated; if 0, then no depletion occurs */
    double G;            /* cumulative energy of tile flake                  */
+   double dG_bonds;     /* the bond and hydrolysis part of G alone          */
+   int perimeter;       /* # tile edges facing an empty cell                */
    int seed_i,seed_j;   /* special site which won't change                  */
    Trep seed_n; 
    evint events;     /* total on, off, hydrolysis events in this flake   */
@@ -176,9 +279,31 @@ typedef struct flake_struct {
    int seed_is_vdouble_tile;          /* same for vdoubles */
    int mismatches;                   /* number of se edges that don't agree              */
    struct flake_struct *next_flake;  /* for NULL-terminated linked list     */
-   struct flake_tree_struct *tree_node;  /* for tree of flakes              */
+   struct flake_struct *prev_flake;  /* ... doubly linked, for O(1) unlink  */
+   int flake_index;     /* slot in tube->flakes[] and leaf of the flake     */
+   /* sum tree, or -1 if not in a tube                 */
+   cell_list *off;      /* off-rate classes, when tube->off_lazy; the flake */
+   int off_n;           /* off-rate is Rate(0,0,0) + sum over s of          */
+   /* off[s].len * tube->off_rate[s]                   */
+   cell_list *sites;    /* empty sites next to the flake, by signature id   */
+   int sites_n;         /* (see tube->sigs)                                 */
+   int *tile_sites;     /* [n]: # sites where tile n could attach, so the   */
+   /* on-rate is k sum over n of conc[n] tile_sites[n] */
+   int *tile_at;        /* [n]: 1 + the flake's place in tube->tile_fl[n],  */
+   /* or 0 if it isn't there                           */
    int *is_present;                  /* records whether each of the watched
                                         tile types are present              */
+   int box_i0, box_i1,  /* rows and columns holding tiles: every tile lies  */
+       box_j0, box_j1;  /* in [i0,i1]x[j0,j1]; i0>i1 for an empty field     */
+   int *row_tiles,      /* [i], [j]: # tiles in row i, column j; kept by    */
+       *col_tiles;      /* change_cell() so the box shrinks exactly         */
+   int live_i0, live_i1,/* cells outside [i0,i1]x[j0,j1] have been left     */
+       live_j0, live_j1;/* behind by a moving window, and are Frozen        */
+   int origin_i,        /* where cell 0,0 is in the field the flake started */
+       origin_j;        /* in, after expanding and sliding                  */
+   frozen_page **frozen;/* [t]: what page t's cells have set aside, or     */
+   /* NULL; the table is NULL until one is [freeze]    */
+   double frozen_rate;  /* sum of the off-rates set aside by tube->freeze   */
 
    int flake_ID;        /* which flake is this (for display use only)       */
    void *chain_hash;    /* When flake has visited particular states;        */
@@ -189,11 +314,22 @@ typedef struct flake_struct {
 
 } flake;          
 
-typedef struct flake_tree_struct {
-   struct flake_tree_struct *left, *right, *up;    /* up==NULL iff root     */
-   flake *fp;                         /* if fp != NULL, left==right==NULL   */
-   int empty; double rate;            /* analogous to empty & rate in flake */
-} flake_tree;
+/* index entry for the attachment candidates at an empty site.  the key   */
+/* is the bond class (see tube->bond_class) that each of the N E S W      */
+/* neighbours presents to the site;                                       */
+/* tiles[] lists, in increasing order, every tile type n that the model    */
+/* would let attach there: Gse>0 for kTAM, Gse>=T for aTAM.                */
+typedef struct site_sig_struct {
+   int nN, nE, nS, nW;
+   int ntiles;
+   Trep *tiles;
+} site_sig;
+
+/* [atam] an empty site in the frontier of atam_simulate()             */
+typedef struct atam_site_struct {
+   struct flake_struct *fp;
+   int i, j;
+} atam_site;
 
 typedef struct assembly_list_struct {
    struct assembly_list_struct *next;
@@ -238,14 +374,56 @@ typedef struct tube_struct {
    double Gmc;          /* Gmc                                              */
    double next_update_t;   /* Precompute next update time                   */
    Trep N, P;  /* # non-empty tile types; 2^P active cell grid     */
+   Trep max_P; /* while P < max_P, the field doubles whenever a     */
+   /* flake comes near its edge (see expand_tube)      */
+   int slide_dir;       /* if >= 0 (N E S W), a full-size field is a window */
+   int slide_live;      /* that moves that way with the growth front,       */
+   FILE *slide_fp;      /* keeping slide_live rows behind it; the rest goes */
+   int slides;          /* to slide_fp, one slide{} block per move          */
+   double freeze;       /* if > 0, a tile whose off-rate is below freeze    */
+   /* times its flake's total is left out of the rate  */
+   /* tree until a neighbour changes; frozen_rate sums */
+   double frozen_rate,  /* what is left out, over all flakes, and           */
+          frozen_missed;/* frozen_missed integrates it over time: the       */
+   /* expected # of events the approximation has lost  */
+   double flicker;      /* if > 0, a weakly attaching tile whose off-rate   */
+   /* is at least flicker times the rest of the tube's */
+   /* has its attach/detach round trip decided at once */
+   evint flickers;      /* # of round trips done that way                   */
+   struct flake_struct *flick_fp; /* a tile that lost that race: its off-   */
+   int flick_i, flick_j;/* event can't be the next event                    */
 
    int num_flakes;      /* how many flakes do we have here?                 */
    int total_flakes;    /* how many flakes have we made, total 
                            (in tinybox may not be the same as num_flakes)   */
    int largest_flake;    /* id of largest flake                              */
    int largest_flake_size; /* size of largest flake                          */
+   int big_size,        /* [ffs] if > 0, big_flakes counts the flakes with  */
+       big_flakes;      /* at least big_size tiles                          */
+   int atam;            /* [atam] if > 0 (needs T > 0), simulate() runs the */
+   /* aTAM without rates, by the frontier of empty     */
+   /* sites where a tile could attach, taken at random */
+   /* (1) or in the order they opened (2)              */
+   atam_site *atam_front;  /* the frontier is atam_front[atam_head...       */
+   int atam_head,       /* atam_n-1]; it is rebuilt if atam_n < 0, or if    */
+       atam_n,          /* events has moved on from atam_events, as when    */
+       atam_cap;        /* tiles were changed some other way               */
+   evint atam_events;
+   evint atam_nondet;   /* # sites filled when more than one tile could go  */
+   int atam_nd_flake,   /* the first such: flake, position in the field the */
+       atam_nd_i,       /* flake started in, and two of the tile types      */
+       atam_nd_j;
+   Trep atam_nd_n[2];
+   evint validate,      /* [validate] if > 0, validate_tube() recounts the  */
+         validate_next; /* kept state from scratch every validate events;  */
+   int validate_runs;   /* how often it has, and the discrepancies it found */
+   evint validate_bad;
    flake *flake_list;   /* for NULL-terminated linked list                  */
-   flake_tree *flake_tree; /* binary tree for fast event selection          */
+   flake **flakes;      /* registry: flakes[0...num_flakes-1], unordered    */
+   int flake_slots;     /* capacity of flakes[]; always a power of 2        */
+   double *flake_rates; /* sum tree for fast flake selection, as a heap:    */
+   /* flake k's total rate is at [flake_slots+k], node */
+   /* n holds [2n]+[2n+1], and [1] is the tube total   */
    int default_seed_i,   /* The last seed_i stated, which is used in creating
                             new flakes */
        default_seed_j;
@@ -269,11 +447,46 @@ typedef struct tube_struct {
    /* conc[n] =def= exp(-Gmc[n])                       */
    double *Gcb;         /* neg std free energy of chemical bonds in tile    */
    /* (zero typically; pos for hydrolysis models)      */
-   double **Gse_EW;     /* bond energy between east-west oriented tiles     */
-   /* Gse_EW[n1][n2] =  n1's west se  : n2's east se   */
-   double **Gse_NS;     /* Gse_NS[n1][n2] =  n1's south se : n2's north se  */
+   int *bond_class;     /* edge bond class of each tile: [4*n+d], d=N E S W */
+   /* tiles with the same bond type on an edge share   */
+   /* its class, unless hydrolysis or a double-tile    */
+   /* pairing sets them apart (see set_Gses)           */
+   int num_bond_classes;
+   double *Gse_bond;    /* bond energy between classes c1,c2, at           */
+   /* [c1*num_bond_classes+c2]; read via the macros    */
+   /* Gse_EW(tp,n1,n2) =  n1's west se  : n2's east se */
+   /* Gse_NS(tp,n1,n2) =  n1's south se : n2's north se*/
+   unsigned char *mism_bond; /* 1 if classes c1,c2 are a mismatch, same   */
+   /* layout as Gse_bond; see Mism()                   */
    /* NOTE n could be empty tile, for which Gse = 0    */
    /* coordinate system is: i+,j+ moves S,E            */
+   int off_lazy;        /* if set, occupied cells are left out of the rate  */
+   /* pyramid and grouped by total bond strength, so   */
+   /* a change of Gse only rescales off_rate[] (used   */
+   /* for anneals; needs kTAM, no hydrolysis, no       */
+   /* double tiles and no chunk fission)               */
+   double *unit_bond;   /* as Gse_bond, in units of Gse                     */
+   double off_Gse;      /* the Gse that Gse_bond and off_rate[] were set at */
+   int num_off_classes, off_cap;
+   double *off_units,   /* total bond strength of class s, in units of Gse  */
+          *off_rate,    /* k exp(-off_Gse off_units[s]), per cell in s      */
+          *off_w;       /* scratch weights for choose_cell()                */
+   int *off_hash;       /* open hash, size 2*off_cap, of s+1 by off_units   */
+   site_sig *sigs;      /* every neighbour signature seen so far, by id;    */
+   int num_sigs,        /* ids are never reused, and set_Gses() re-        */
+       sigs_cap;        /* evaluates tiles[] in place                      */
+   int *sig_table;      /* open hash from signature to id+1                 */
+   int sig_size;
+   int **sigs_with,     /* [n]: ids of the signatures that admit tile n     */
+       *num_sigs_with;
+   tile_flakes *tile_fl;/* [n]: the flakes with sites for tile n, and the   */
+   /* tube's total of tile_sites[n] at .sites[1]       */
+   int on_slots;        /* smallest power of 2 > N                          */
+   double *on_tree,     /* sum trees over tile types, laid out as           */
+          *conc_tree;   /* flake_rates: tile n's leaf at [on_slots+n] is    */
+   /* conc[n] * tube total of tile_sites[n] (on_tree), */
+   /* or conc[n] (conc_tree); see fix_on_rate()        */
+   xgrow_rng rng;       /* all random choices in simulate() come from here  */
    double t;            /* cumulative time in seconds                       */
    evint events;     /* cumulative number of events                      */
    evint stat_a,stat_d,/* tally of number of association, dissociation,  */
@@ -299,6 +512,20 @@ typedef struct tube_struct {
 
 } tube;          
 
+/* [ffs] the flakes and free concentrations of a tube, for putting back */
+/* later with restore_tube; t, events and the stats aren't part of it.  */
+typedef struct tube_state_struct {
+   double *conc;        /* conc[0..N]                                       */
+   int num_flakes, len; /* flakes, and ints in cells[]                      */
+   int *cells;          /* per flake: seed_i seed_j seed_n double vdouble m,*/
+   /* then m (i j n) triples, seed included            */
+   double *flake_conc;  /* per flake                                        */
+   int *flake_ID;       /* per flake, and the tube's count of flakes made,  */
+   int total_flakes;    /* given back on restoring                          */
+   int size;            /* largest flake when saved                         */
+   int parent;          /* the state at the previous interface it came from */
+} tube_state;
+
 extern int periodic;    /* simulation on torus */
 extern int wander;      /* of seed tile designation */
 extern int fission_allowed; /* allow dissociation that breaks flake in two? */
@@ -318,8 +545,15 @@ flake *init_flake(Trep P, Trep N,
 flake *free_flake(flake *fp);
 void free_tube(tube *tp);
 void set_Gses(tube *tp, double Gse, double Gseh);
+void reset_site_index(tube *tp);
+void rng_seed(xgrow_rng *rng, unsigned long long seed);
+void rng_jump(xgrow_rng *rng);
+void rng_split(xgrow_rng *parent, xgrow_rng *child);
+double rng_exp(xgrow_rng *rng);
+int site_signature(flake *fp, int i, int j);
 void insert_flake(flake *fp, tube *tp);
-void print_tree(flake_tree *ftp, int L, char s);
+void print_tree(tube *tp);
+void reset_flake_registry(tube *tp);
 void clean_flake(flake *fp, double X, int iters);
 void fill_flake(flake *fp, double X, int iters);
 void error_radius_flake(flake *fp, double rad);
@@ -334,13 +568,32 @@ void reset_params(tube *tp, double old_Gmc, double old_Gse,
 void recalc_G(flake *fp);
 double calc_dG_bonds(flake *fp);
 int calc_perimeter(flake *fp);
+int check_flake_stats(flake *fp);
+int validate_tube(tube *tp);
+int write_checkpoint(tube *tp, char *fn);
+int read_checkpoint(tube *tp, char *fn);
 void update_all_rates(tube *tp);
+void expand_tube(tube *tp);
+void free_pools(void);
+void write_slide_windows(tube *tp);
 void update_rates(flake *fp, int ii, int jj);
 void update_tube_rates(flake *fp);
+void flake_box(flake *fp, int margin, int *i0, int *i1, int *j0, int *j1);
+double tube_on_rate(tube *tp);
+void reset_conc_trees(tube *tp);
+flake *choose_on_event(tube *tp, int *ip, int *jp, int *np);
 void change_cell(flake *fp, int i, int j, Trep n);
 void change_seed(flake *fp, int new_i, int new_j);
 int flake_fission(flake *fp, int i, int j);
 void simulate(tube *tp, evint events, double tmax, int emax, int smax, int fsmax, int smin, int mmax);
+int largest_flake_now(tube *tp);
+tube_state *save_tube(tube *tp);
+void restore_tube(tube *tp, tube_state *s);
+tube_state *copy_tube_state(tube_state *s, int N);
+void free_tube_state(tube_state *s);
+void ffs_simulate(tube **wk, int nwk, int threads, int n_ifc, int *ifc, int trials, 
+      double t_basin, FILE *out);
+void split_simulate(tube **wk, int nwk, int threads, int per_bin, double dt_seg, double tmax);
 void linear_simulate( double ratek, double Gmc, double Gse,
       double tmax, int emax, int smax, int mmax);
 
@@ -0,0 +1,156 @@
+#!/bin/sh
+# Regression checks that need a whole run rather than a unit of grow.c:
+#
+#  - a run stopped at a checkpoint= and carried on with restart= must
+#    write the same datafile line as the same run done in one go;
+#  - validate= must find no discrepancies between the kept rates, sums
+#    and counts and a recount from scratch, in the modes that keep them
+#    differently, with flake_conc (Gfc) drawing the tiles down, and
+#    with vertical double tiles (the zig-zag set turned on its side);
+#  - ffs= must report the same, and write the same ffsfile, whether its
+#    trials run on one thread or several, and so must split= with its
+#    replicas;
+#  - a ribbon grown irreversibly with slide= in a small field, put back
+#    together from its slidefile, must match the same ribbon grown in a
+#    field wide enough to hold it;
+#  - atam=fifo must reach the same terminal assembly as the kTAM engine
+#    at T=2 run for as many events.
+#
+# usage: src/regress.sh [xgrow]
+# without an xgrow binary, one is built from src/ with $CC (default cc).
+# prints a line per check, and exits 1 if any failed.
+
+here=$(cd "$(dirname "$0")" && pwd)
+tiles=$here/../old-stuff/tilesets
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+if [ $# -gt 0 ]; then
+   xgrow=$1
+else
+   ${CC:-cc} -O2 "$here/xgrow.c" "$here/grow.c" -o "$tmp/xgrow" -lm -lpthread -lX11 || exit 1
+   xgrow=$tmp/xgrow
+fi
+cd "$tiles" || exit 1
+fail=0
+
+# zig-zag with its bonds {N E S W} turned to {W N E S}: its double tiles
+# become vertical ones
+sed -e 's/{ *\([^ }]*\) *\([^ }]*\) *\([^ }]*\) *\([^ }]*\) *}/{\4 \1 \2 \3}/' \
+    -e 's/^doubletile=/vdoubletile=/' zig-zag-5w-2.5-4.9.tiles >"$tmp/vdouble.tiles"
+
+# restart NAME TILEFILE OPTIONS...: 150000 + 150000 events against 300000
+restart() {
+   name=$1; shift
+   rm -f "$tmp/straight" "$tmp/restarted" "$tmp/ck"
+   "$xgrow" "$@" emax=300000 datafile="$tmp/straight" >/dev/null 2>&1
+   "$xgrow" "$@" emax=150000 checkpoint="$tmp/ck" >/dev/null 2>&1
+   "$xgrow" "$@" emax=300000 restart="$tmp/ck" datafile="$tmp/restarted" >/dev/null 2>&1
+   if [ -s "$tmp/straight" ] && cmp -s "$tmp/straight" "$tmp/restarted"; then
+      echo "ok    restart  $name"
+   else
+      echo "FAIL  restart  $name"; fail=1
+   fi
+}
+
+# validate NAME TILEFILE OPTIONS...: recount every 5000 events
+validate() {
+   name=$1; shift
+   out=$("$xgrow" "$@" validate=5000 2>&1 | grep '^validate:')
+   case "$out" in
+      *" 0 discrepancies") echo "ok    validate $name" ;;
+      *) echo "FAIL  validate $name: ${out:-no validate: line}"; fail=1 ;;
+   esac
+}
+
+# threads NAME KEY TILEFILE OPTIONS...: the KEY: lines, and what the run
+# writes to $tmp/out, with threads=1 against threads=4
+threads() {
+   name=$1; key=$2; shift 2
+   for n in 1 4; do
+      rm -f "$tmp/out"
+      "$xgrow" "$@" threads=$n 2>&1 | grep "^$key:" >"$tmp/threads$n"
+      [ -f "$tmp/out" ] && cat "$tmp/out" >>"$tmp/threads$n"
+   done
+   if [ -s "$tmp/threads1" ] && cmp -s "$tmp/threads1" "$tmp/threads4"; then
+      echo "ok    threads  $name"
+   else
+      echo "FAIL  threads  $name"; fail=1
+   fi
+}
+
+restart  plain          sierpinski.tiles -nw size=128 rand=4
+restart  chunk_fission  sierpinski.tiles -nw size=128 rand=4 chunk_fission
+restart  maxsize        sierpinski.tiles -nw size=32 maxsize=256 rand=4
+restart  freeze         sierpinski.tiles -nw size=128 rand=4 freeze=0.01
+restart  flicker        sierpinski.tiles -nw size=128 rand=4 flicker=1
+restart  tinybox        sierpinski.tiles -nw size=64 rand=4 tinybox=1e-15 Gmc=15 Gse=8.2
+restart  wander         zig-zag-5w-2.5-4.9.tiles -nw rand=4
+
+validate plain          sierpinski.tiles -nw size=128 emax=300000 rand=5
+validate freeze         sierpinski.tiles -nw size=128 emax=300000 rand=5 freeze=0.01
+validate flicker        sierpinski.tiles -nw size=128 emax=300000 rand=5 flicker=0.5
+validate chunk_fission  sierpinski.tiles -nw size=128 emax=300000 rand=5 chunk_fission
+validate maxsize        sierpinski.tiles -nw size=32 maxsize=256 emax=300000 rand=5
+validate tinybox        sierpinski.tiles -nw size=64 emax=300000 rand=5 tinybox=1e-15 Gmc=15 Gse=8.2
+validate wander         zig-zag-5w-2.5-4.9.tiles -nw emax=300000 rand=5
+validate Gfc            sierpinski.tiles -nw size=128 emax=300000 rand=5 Gfc=19
+validate vdouble        "$tmp/vdouble.tiles" -nw emax=300000 rand=5 T=0
+validate vdouble_Gfc    "$tmp/vdouble.tiles" -nw emax=300000 rand=5 T=0 Gfc=9
+
+threads  ffs            ffs   sierpinski.tiles -nw tinybox=1e-15 Gmc=15 Gse=8.2 rand=7 \
+                              ffs=3,5,8,12,20 ffs_time=500 ffs_trials=40 ffsfile="$tmp/out"
+threads  split          split sierpinski.tiles -nw Gmc=16.6 Gse=8.6 rand=3 tmax=3000 split=10,40
+
+# a 2-wide ribbon that grows north from its seed, repeating every 3 rows
+cat >"$tmp/ribbon.tiles" <<EOF
+tile edges matches {{N E S W}*}
+num tile types=8
+num binding types=7
+tile edges={
+{1 4 0 0}
+{2 5 1 0}
+{3 6 2 0}
+{1 7 3 0}
+{0 0 0 4}
+{0 0 0 5}
+{0 0 0 6}
+{0 0 0 7}
+}
+binding strengths={2 2 2 2 2 2 2}
+EOF
+# the cells of slide{} and window{} blocks, as "row col tile" from the seed
+cells='/^(slide|window)\{/ { gsub(/[^-0-9 ]/," "); split($0,h," "); r=h[3]-si; c=h[4]-sj; next }
+       /; \.\.\./ { sub(/^ *\[/,""); sub(/;.*/,""); n=split($0,f," ");
+                    for (k=1;k<=n;k++) if (f[k]>0) print r, c+k-1, f[k]; r++ }'
+rm -f "$tmp/wide" "$tmp/slid"
+"$xgrow" "$tmp/ribbon.tiles" -nw T=2 emax=600 size=512 seed=500,10,1 slide=N slidefile="$tmp/wide" >/dev/null 2>&1
+"$xgrow" "$tmp/ribbon.tiles" -nw T=2 emax=600 size=32 seed=28,10,1 slide=N,12 slidefile="$tmp/slid" >/dev/null 2>&1
+awk -v si=500 -v sj=10 "$cells" "$tmp/wide" >"$tmp/wide.cells"
+awk -v si=28 -v sj=10 "$cells" "$tmp/slid" >"$tmp/slid.cells"
+# every event adds a tile, so both hold 601; the last rows can fill in a
+# different order, so only the cells both hold are compared
+out=$(awk 'NR==FNR { t[$1" "$2]=$3; nw++; next }
+           { ns++; if (($1" "$2) in t) { both++; if (t[$1" "$2]!=$3) bad++ } }
+           END { if (nw!=601 || ns!=601 || both<590 || bad) print nw+0, ns+0, both+0, bad+0 }' \
+      "$tmp/wide.cells" "$tmp/slid.cells")
+if [ -z "$out" ] && grep -q '^slide{' "$tmp/slid" && ! grep -q '^slide{' "$tmp/wide"; then
+   echo "ok    slide    ribbon"
+else
+   echo "FAIL  slide    ribbon: ${out:-didn't slide in the small field, or did in the wide one}"; fail=1
+fi
+
+# the counter is deterministic, so the order its sites fill in doesn't
+# matter; line 3 of an arrayfile holds the time, which does differ
+rm -f "$tmp/atam" "$tmp/ktam" "$tmp/data"
+"$xgrow" BinaryCounter.tiles -nw size=64 T=2 atam=fifo emax=1000000 \
+   arrayfile="$tmp/atam" datafile="$tmp/data" >/dev/null 2>&1
+e=$(awk '{ print $7 }' "$tmp/data")
+"$xgrow" BinaryCounter.tiles -nw size=64 T=2 emax=${e:-1} arrayfile="$tmp/ktam" >/dev/null 2>&1
+if [ -s "$tmp/atam" ] && [ "$(sed 3d "$tmp/atam")" = "$(sed 3d "$tmp/ktam")" ]; then
+   echo "ok    atam     BinaryCounter"
+else
+   echo "FAIL  atam     BinaryCounter"; fail=1
+fi
+
+exit $fail
@@ -226,10 +226,9 @@ void reset_tube (tube *tp) {
   tp->events = 0;
   tp->stat_a = 0;
   tp->stat_d = 0;
-  tp->num_flakes = 0;
   // TODO:  If Gfc is nonzero, restore original concentrations
   tp->flake_list=NULL;
-  tp->flake_tree=NULL;
+  reset_flake_registry(tp);
 
   // Set annealing start point so that tau = max_bond_strength + 1
   max_bond_strength = 0;
@@ -465,6 +464,7 @@ void generate_initial_chain_states (tube *tp, int seed_i, int seed_j, int seed_n
 	clear_seen_states (tp);
 	free_flake(fp);
 	tp->flake_list = NULL;
+	reset_flake_registry(tp);
 	tp->anneal_t *= 1.5;
       }
     }
@@ -245,6 +245,9 @@ the file.  (compatibility with existing xgrow tile files must be maintained.)
 # include <math.h>
 # include <assert.h>
 # include <limits.h>
+# include <pthread.h>
+# include <signal.h>
+# include <time.h>
 
 # include "grow.h"
 #ifdef TESTING_OK
@@ -284,8 +287,10 @@ the file.  (compatibility with existing xgrow tile files must be maintained.)
    
    long int translate[MAXTILETYPES]; /* for converting colors */
    int paused=0, errorc=0, errors=0, sampling=0;
+   int showpic_full=1;  /* next showpic() must redraw the whole field */
    int export_mode=0, export_flake_n=1, export_movie_n=1, export_movie=0; 
-   FILE *export_fp=NULL;
+   FILE *export_fp=NULL; int export_box=0;
+   int check_stats=0;   /* recount each flake's stats when they're written */
    int update_rate=10000;
    static char *progname;
    char stringbuffer[256];
@@ -333,6 +338,27 @@ double min_strength=1;
 
 int NROWS,NCOLS,VOLUME,WINDOWWIDTH,WINDOWHEIGHT;
 int size=256, size_P=8; 
+int maxsize=0, max_P=0;  /* the field may double up to this size [maxsize] */
+int slide_dir=-1, slide_live=0;  /* the field may move with the front [slide] */
+FILE *slidefp=NULL;
+double freeze=0;  /* leave out off-rates below this fraction [freeze] */
+double flicker=0; /* shortcut weak attach/detach round trips [flicker] */
+int atam=0;    /* aTAM by frontier sites: 1 random order, 2 fifo [atam] */
+evint validate=0;  /* recount the kept state every this many events [validate] */
+char *checkpoint_file=NULL, *restart_file=NULL;  /* [checkpoint] */
+double checkpoint_every=600;  /* seconds of wall clock between checkpoints */
+time_t checkpoint_last;
+volatile sig_atomic_t checkpoint_now=0;  /* set by SIGUSR1 */
+int ffs_n=0, *ffs_ifc=NULL, ffs_trials=100;  /* interfaces, trials each [ffs] */
+double ffs_time=10000;  /* basin run, in seconds [ffs] */
+FILE *ffsfp=NULL;
+int split_n=0;  double split_dt=0;  /* replicas per bin, seconds per round [split] */
+int replicas=1, threads=1;  /* independent runs, and threads to run them [replicas] */
+int sweep_n=0, sweep_m=0, sweep_warm=0, sweep_back=0;  /* points, and how [sweep] */
+double sweep_gmc[2], sweep_gse[2];
+int phase_n=0, phase_samples=8;  /* Gmc values, bursts per measurement [phase] */
+double phase_gmc[2], phase_gse[2], phase_time=0, phase_tol=0.02;
+FILE *phasefp=NULL;
 int block=1; /* default to small blocks; calling with argument changes this */
 int wander, periodic, linear, fission_allowed, zero_bonds_allowed; 
 FILE *tracefp, *datafp, *arrayfp, *tilefp, *largeflakefp;
@@ -349,6 +375,7 @@ int clean_cycles=0; double clean_X=1.0; int fill_cycles=0; double fill_X=1.0;
 double error_radius=0.0; double repair_unique_T=2.0; int repair_unique=0;
 double tmax; int emax, smax, fsmax, smin, mmax;
 int seed_i,seed_j,seed_n;
+xgrow_rng main_rng;  /* seeded by rand=; each new tube gets a substream of it */
 double tinybox = 0;
 double anneal_h, anneal_s, startC, endC, seconds_per_C = 0;
 double anneal_g, anneal_t = 0;
@@ -377,8 +404,63 @@ int parse_arg_line(char *arg)
       block=MAX(1,MIN(30,atoi(&arg[6])));
    else if (IS_ARG_MATCH(arg,"size=")) 
       size=MAX(32,MIN(4096,atoi(&arg[5])));
+   else if (IS_ARG_MATCH(arg,"maxsize=")) 
+      maxsize=MAX(32,MIN(65536,atoi(&arg[8])));
+   else if (IS_ARG_MATCH(arg,"slide=")) {
+      char *p=strchr("NESW",arg[6]);
+      if (arg[6]==0 || p==NULL) {
+	 fprintf(stderr,"Usage : slide=D[,L] with D one of N, E, S, W\n");
+	 return -1;
+      }
+      slide_dir=p-"NESW";
+      if ((p=strchr(&arg[6],','))!=NULL) slide_live=MAX(1,atoi(p+1));
+   }
+   else if (IS_ARG_MATCH(arg,"flicker=")) flicker=MAX(0,atof(&arg[8]));
+   else if (strcmp(arg,"atam")==0 || strcmp(arg,"atam=random")==0) atam=1;
+   else if (strcmp(arg,"atam=fifo")==0) atam=2;
+   else if (IS_ARG_MATCH(arg,"freeze=")) freeze=MAX(0,atof(&arg[7]));
+   else if (IS_ARG_MATCH(arg,"slidefile=")) slidefp=fopen(strtok(&arg[10],newline), "w");
+   else if (IS_ARG_MATCH(arg,"ffs=")) {
+      char *p=&arg[4];  int k;
+      for (ffs_n=1; (p=strchr(p,','))!=NULL; p++) ffs_n++;
+      ffs_ifc = (int *) realloc(ffs_ifc,ffs_n*sizeof(int));
+      for (k=0, p=&arg[4]; k<ffs_n; k++, p=strchr(p,',')+1) ffs_ifc[k]=atoi(p);
+   }
+   else if (IS_ARG_MATCH(arg,"split=")) {
+      char *p=strchr(&arg[6],',');
+      split_n=MAX(1,atoi(&arg[6]));
+      if (p==NULL || (split_dt=atof(p+1))<=0) {
+	 fprintf(stderr,"Usage : split=K,dt with dt > 0\n");
+	 return -1;
+      }
+   }
+   else if (IS_ARG_MATCH(arg,"replicas=")) replicas=MAX(1,atoi(&arg[9]));
+   else if (IS_ARG_MATCH(arg,"threads=")) threads=MAX(1,atoi(&arg[8]));
+   else if (IS_ARG_MATCH(arg,"sweep=")) {
+      if (sscanf(&arg[6],"%lf,%lf,%lf,%lf,%d,%d",&sweep_gmc[0],&sweep_gse[0],
+	       &sweep_gmc[1],&sweep_gse[1],&sweep_n,&sweep_m) < 5 || sweep_n<1 || sweep_m<0) {
+	 fprintf(stderr,"Usage : sweep=Gmc0,Gse0,Gmc1,Gse1,n[,m]\n");
+	 return -1;
+      }
+   }
+   else if (strcmp(arg,"warmstart")==0) sweep_warm=1;
+   else if (IS_ARG_MATCH(arg,"phase=")) {
+      if (sscanf(&arg[6],"%lf,%lf,%d,%lf,%lf",&phase_gmc[0],&phase_gmc[1],&phase_n,
+	       &phase_gse[0],&phase_gse[1]) < 5 || phase_n<1 || phase_gse[1]<=phase_gse[0]) {
+	 fprintf(stderr,"Usage : phase=Gmc0,Gmc1,n,Gse0,Gse1 with Gse0 < Gse1\n");
+	 return -1;
+      }
+   }
+   else if (IS_ARG_MATCH(arg,"phase_samples=")) phase_samples=MAX(2,atoi(&arg[14]));
+   else if (IS_ARG_MATCH(arg,"phase_time=")) phase_time=atof(&arg[11]);
+   else if (IS_ARG_MATCH(arg,"phase_tol=")) phase_tol=atof(&arg[10]);
+   else if (IS_ARG_MATCH(arg,"phasefile=")) phasefp=fopen(strtok(&arg[10],newline), "w");
+   else if (strcmp(arg,"sweepback")==0) sweep_back=1;
+   else if (IS_ARG_MATCH(arg,"ffs_trials=")) ffs_trials=MAX(1,atoi(&arg[11]));
+   else if (IS_ARG_MATCH(arg,"ffs_time=")) ffs_time=atof(&arg[9]);
+   else if (IS_ARG_MATCH(arg,"ffsfile=")) ffsfp=fopen(strtok(&arg[8],newline), "w");
    else if (IS_ARG_MATCH(arg,"rand=")) 
-   { srand48(atoi(&arg[5])); srandom(atoi(&arg[5])); }
+   { srand48(atoi(&arg[5])); srandom(atoi(&arg[5])); rng_seed(&main_rng,atoi(&arg[5])); }
    else if (IS_ARG_MATCH(arg,"k=")) ratek=atof(&arg[2]);
    else if (IS_ARG_MATCH(arg,"Gmc=")) Gmc=atof(&arg[4]);
    else if (IS_ARG_MATCH(arg,"Gse=")) Gse=atof(&arg[4]);
@@ -609,6 +691,15 @@ int parse_arg_line(char *arg)
    }
    else if (IS_ARG_MATCH(arg,"arrayfile=")) arrayfp=fopen(strtok(&arg[10],newline), "w");
    else if (IS_ARG_MATCH(arg,"exportfile=")) export_fp=fopen(strtok(&arg[11],newline), "w");
+   else if (IS_ARG_MATCH(arg,"export_box")) export_box=1;
+   else if (IS_ARG_MATCH(arg,"check_stats")) check_stats=1;
+   else if (IS_ARG_MATCH(arg,"validate=")) validate=strtoull(&arg[9],NULL,10);
+   else if (IS_ARG_MATCH(arg,"checkpoint=")) {
+      char *p;
+      checkpoint_file=strdup(strtok(&arg[11],newline));
+      if ((p=strchr(checkpoint_file,','))!=NULL) { *p=0; checkpoint_every=atof(p+1); }
+   }
+   else if (IS_ARG_MATCH(arg,"restart=")) restart_file=strdup(strtok(&arg[8],newline));
    else if (strncmp(arg,"testing",7) == 0) {
       testing = 1;
    }
@@ -848,6 +939,7 @@ void getargs(int argc, char **argv)
    int i; struct flake_param *fprm;
    struct timeval tv; 
    gettimeofday(&tv, NULL); srand48(tv.tv_usec); srandom(tv.tv_usec);
+   rng_seed(&main_rng,tv.tv_usec);
    /* NOTE: Disabled to allow compilation on 64-bit systems; doesn't seem to cause problems. (cge, 091028)
       if (sizeof(long) != 4) {
       printf("Error: sizeof long (%d) should be 4\n", (int)sizeof(long int));
@@ -860,8 +952,34 @@ void getargs(int argc, char **argv)
       printf(" options:\n");
       printf("  block=  display block size, 1...10\n");
       printf("  size=   field side length (power-of-two) [default 256]\n");
+      printf("  maxsize= double the field, keeping flakes centred, whenever one nears\n"
+	    "          the edge, up to this side length (needs -nw; not with periodic or blast)\n");
+      printf("  slide=D[,L] for a flake growing towards side D (N, E, S or W): when it nears\n"
+	    "          that edge of the (full size) field, move the field along, keeping the\n"
+	    "          last L rows behind the front [default size/4].  the rest is written to\n"
+	    "          the slidefile, and stats are for what's left.  not with periodic,\n"
+	    "          tinybox, blast or double tiles\n");
+      printf("  slidefile= where slide writes what it leaves behind, as slide{} blocks of\n"
+	    "          [flake row col] of the top left cell (in the starting field) and the\n"
+	    "          cells, then window{} blocks for the rest at exit\n"
+	    "          [defaults to 'xgrow_slide_output']\n");
+      printf("  freeze=X approximate: a tile whose off-rate is below X times its flake's total\n"
+	    "          off-rate has no events until a neighbour changes; the expected number\n"
+	    "          of events this left out is printed at exit [default 0, exact]\n");
+      printf("  flicker=Y when a tile attaches whose off-rate is at least Y times the rest of\n"
+	    "          the total rate, decide at once whether it falls off before anything\n"
+	    "          else happens; exact, except that with freeze= the rest is as freeze\n"
+	    "          would have it before the attachment (kTAM only; not with wander,\n"
+	    "          tinybox, blast, anneals, double tiles, chunk_fission or untiltiles)\n"
+	    "          [default 0, off; lower Y shortcuts more attachments]\n");
       printf("  rand=   random number seed\n");
       printf("  T=      threshold T (relative to Gse) for irreversible Tile Assembly Model\n");
+      printf("  atam[=random|fifo]    with T, assemble by a work-queue of the sites where a\n"
+	    "                        tile can attach, with no rates: taken at random, or\n"
+	    "                        in the order they opened (deterministic); reports\n"
+	    "                        sites where more than one tile type could attach\n"
+	    "                        (not with hydro, tinybox, blast, double tiles, slide,\n"
+	    "                        anneals, sweep, phase or split)\n");
       printf("  k=      hybridization rate constant (/sec)\n");
       printf("  Gmc=    initiation free energy  (units kT)\n");
       printf("  Gse=    interaction free energy per binding\n");
@@ -882,6 +1000,59 @@ void getargs(int argc, char **argv)
       printf("                        (in incremenets of 0.1C).  Ignores Gse value.\n");
       printf("  seed=i,j,n            seed tile type n at position i,j\n");
       printf("  tinybox=V             use dynamic flakes in a box of volume V (in liters).\n");
+      printf("  replicas=K            with -nw, run K independent copies of the simulation\n"
+	    "                        (each with its own random numbers; the first is the one\n"
+	    "                        you'd get without this) and write the datafile line,\n"
+	    "                        arrayfile flakes and trace lines of each in turn\n");
+      printf("  threads=T             run the replicas (or ffs= trials, or split= rounds)\n"
+	    "                        on T threads [default 1]\n");
+      printf("  sweep=Gmc0,Gse0,Gmc1,Gse1,n[,m]  with -nw, run n conditions evenly spaced\n"
+	    "                        from (Gmc0,Gse0) to (Gmc1,Gse1), or if m is given, the\n"
+	    "                        grid of n Gmc by m Gse values, each to the given limits\n"
+	    "                        (t and events count from 0 at each); one datafile line\n"
+	    "                        (per flake) per condition, in order.  Gfc moves with Gmc\n"
+	    "                        as when Gmc is changed in the window\n");
+      printf("  warmstart             in a sweep, go on from where the last condition left\n"
+	    "                        the flakes: along the path, or along Gse for each Gmc\n"
+	    "                        of a grid; lines are written before clean/fill fix-ups\n");
+      printf("  sweepback             in a warmstart sweep, come back the same way after\n"
+	    "                        the last condition, to show hysteresis\n");
+      printf("  phase=Gmc0,Gmc1,n,Gse0,Gse1  with -nw, find the Gse where the starting\n"
+	    "                        flakes go from melting to growing, for n Gmc values from\n"
+	    "                        Gmc0 to Gmc1, by bisection between Gse0 and Gse1; each\n"
+	    "                        Gse tried gets bursts from the starting state until the\n"
+	    "                        sign of the mean growth rate is clear (2 standard errors)\n"
+	    "                        or 4x phase_samples bursts don't settle it, which ends\n"
+	    "                        that Gmc as unresolved, with the bracket it got to\n"
+	    "                        (Gse is nan in phasefile).  Gmc values run on threads=;\n"
+	    "                        datafile gets Gmc Gse rate(tiles/s) stderr bursts for\n"
+	    "                        each Gse tried.\n"
+	    "                        The starting flakes are where the usual run to the\n"
+	    "                        given limits (e.g. smax=) leaves them, if any are given\n");
+      printf("  phase_samples=K       bursts per measurement to start with [default 8]\n");
+      printf("  phase_time=t          seconds per burst [default 20 e^Gmc / k, i.e. about\n"
+	    "                        20 arrivals at each site]\n");
+      printf("  phase_tol=dG          stop bisecting at this width in Gse [default 0.02]\n");
+      printf("  phasefile=            where the boundary goes, as Gmc Gse Gse_lo Gse_hi\n"
+	    "                        bursts per line [defaults to 'xgrow_phase_output']\n");
+      printf("  split=K,dt            with -nw and tmax, estimate mismatches per tile from a\n"
+	    "                        weighted ensemble: replicas are binned by the number of\n"
+	    "                        mismatches every dt seconds, and each bin is split or\n"
+	    "                        merged back to K replicas, so rare errors get as many\n"
+	    "                        replicas as the rest; prints the weight of each bin and\n"
+	    "                        the estimate, and quits.  Each round's replicas are\n"
+	    "                        dealt out to one tube per thread, as for ffs=\n");
+      printf("  ffs=s0,s1,...,sn      with tinybox and -nw, estimate the rate at which the\n"
+	    "                        largest flake reaches size sn, by forward flux sampling\n"
+	    "                        through these sizes, and quit.  The trials from each\n"
+	    "                        size are dealt out to one tube per thread, each trial\n"
+	    "                        with its own random numbers\n");
+      printf("  ffs_trials=M          trial runs from each size [default 100]\n");
+      printf("  ffs_time=t            seconds of the first run, for the flux through s0\n"
+	    "                        [default 10000]\n");
+      printf("  ffsfile=              where the largest flake at each size is written, for\n"
+	    "                        each path that got to sn, as ffs_path{p}{i} blocks\n"
+	    "                        like slide{} [defaults to 'xgrow_ffs_output']\n");
       printf("  addflakes=i,j,n:N@Gfc simulate N separate flakes\n");
       printf("  stripe=o[:p,w]*       width w stripe with p errors, offset o\n");
       printf("  wander                wandering `seed' designation\n");
@@ -919,9 +1090,21 @@ void getargs(int argc, char **argv)
       printf("  repair_unique_T=      alternative clean/fill, called Rx: remove mismatches, fill in interior sites \n"
 	    "                        if there is a unique strength-T tile, then fill in by strongest tile\n");
       printf("  datafile=             append Gmc, Gse, ratek, time, size, #mismatched se, events, perimeter, dG, dG_bonds for each flake\n");
+      printf("  check_stats           whenever the above are written, recount perimeter, dG_bonds & #mismatches\n"
+	    "                        from scratch and report any that disagree with the running totals\n");
+      printf("  validate=K            every K events, recount rates, sum trees, G, tiles, mismatches and\n"
+	    "                        concentrations from scratch, and report on stderr each that was kept\n"
+	    "                        wrong, and by how much (for debugging) [default 0, never]\n");
+      printf("  checkpoint=FILE[,S]   every S seconds [default 600], on SIGUSR1, and at the end, write the\n"
+	    "                        whole state of the run to FILE (by way of FILE.tmp), for restart=\n");
+      printf("  restart=FILE          go on from a checkpoint, exactly as the run that wrote it would have;\n"
+	    "                        give the same tile set and options (emax= etc. may be raised)\n");
       printf("  arrayfile=            output MATLAB-format flake array information on exit (after cleaning)\n");
       printf("  exportfile=           on-request output of MATLAB-format flake array information\n");
       printf("                        [defaults to 'xgrow_export_output']\n");
+      printf("  export_box            exported arrays cover only the rows & columns holding tiles,\n"
+	    "                        followed by [row col] of their top left cell (0-based);\n"
+	    "                        such files can't be read back with importfile\n");
       printf("  importfile=FILENAME   import all flakes from FILENAME.\n");
       printf("  importfile            import all flakes from xgrow_export_output.\n");
       printf("  pause                 start in paused state; wait for user to request simulation to start.\n");
@@ -956,7 +1139,7 @@ void getargs(int argc, char **argv)
    for (i=2; i<argc; i++) {
       parse_arg_line(argv[i]);
    }
-   if (tmax==0 && emax==0 && smax==0 && mmax==0 && fsmax==0 && smin==-1) {
+   if (tmax==0 && emax==0 && smax==0 && mmax==0 && fsmax==0 && smin==-1 && ffs_n==0 && phase_n==0) {
      printf("No max setting: forcing UI mode.\n");
      XXX=1;
    }
@@ -984,6 +1167,63 @@ void getargs(int argc, char **argv)
 
    for (size_P=5; (1<<size_P)<size; size_P++);
    size=(1<<size_P); 
+   for (max_P=size_P; (1<<max_P)<maxsize; max_P++);
+   if (max_P>size_P && (XXX || periodic || blast_rate_alpha>0)) {
+      printf("* maxsize= needs -nw, and can't be used with periodic or blast; ignoring it.\n");
+      max_P=size_P;
+   }
+   if (slide_dir>=0 && (periodic || tinybox>0 || blast_rate_alpha>0 || double_tiles || vdouble_tiles)) {
+      printf("* slide= can't be used with periodic, tinybox, blast or double tiles; ignoring it.\n");
+      slide_dir=-1;
+   }
+   if (slide_live==0) slide_live=(1<<max_P)/4;
+   for (i=1; i<ffs_n && ffs_ifc[i]>ffs_ifc[i-1]; i++);
+   if (ffs_n>0 && (XXX || tinybox==0 || max_P>size_P || ffs_n<2 || i<ffs_n || ffs_ifc[0]<2)) {
+      printf("* ffs= needs tinybox and -nw, not maxsize, and at least two increasing sizes\n"
+	    "  from 2 up; ignoring it.\n");
+      ffs_n=0;
+   }
+   if (atam>0 && (T<=0 || hydro || tinybox>0 || blast_rate_alpha>0 || double_tiles || 
+	    vdouble_tiles || slide_dir>=0 || anneal_t || seconds_per_C || sweep_n>0 || 
+	    phase_n>0 || split_n>0)) {
+      printf("* atam needs T>0, and can't be used with hydro, tinybox, blast, double tiles,\n"
+	    "  slide, anneals, sweep, phase or split; ignoring it.\n");
+      atam=0;
+   }
+   if (validate>0 && atam>0) {
+      printf("* validate= has no rates to check under atam; ignoring it.\n");
+      validate=0;
+   }
+   if (sweep_n>0 && (XXX || hydro || anneal_t || seconds_per_C || slide_dir>=0 || ffs_n>0 || 
+	    split_n>0 || stripe_args!=NULL || import || export_mode==2)) {
+      printf("* sweep= needs -nw, and can't be used with hydro, anneals, slide, ffs, split,\n"
+	    "  stripe, importfile or movie exports; ignoring it.\n");
+      sweep_n=0;
+   }
+   if (phase_n>0 && (XXX || hydro || anneal_t || seconds_per_C || slide_dir>=0 || ffs_n>0 ||
+	    split_n>0 || sweep_n>0 || replicas>1 || stripe_args!=NULL || export_mode==2)) {
+      printf("* phase= needs -nw, and can't be used with hydro, anneals, slide, ffs, split,\n"
+	    "  sweep, replicas, stripe or movie exports; ignoring it.\n");
+      phase_n=0;
+   }
+   if (replicas>1 && (XXX || slide_dir>=0 || ffs_n>0 || split_n>0 || stripe_args!=NULL ||
+	    import || export_mode==2)) {
+      printf("* replicas= needs -nw, and can't be used with slide, ffs, split, stripe,\n"
+	    "  importfile or movie exports; ignoring it.\n");
+      replicas=1;
+   }
+   if (split_n>0 && (XXX || tmax==0 || max_P>size_P || slide_dir>=0 || untiltiles || ffs_n>0)) {
+      printf("* split= needs -nw and tmax, and can't be used with maxsize, slide,\n"
+	    "  untiltiles or ffs; ignoring it.\n");
+      split_n=0;
+   }
+   if ((checkpoint_file!=NULL || restart_file!=NULL) && (replicas>1 || sweep_n>0 ||
+	    phase_n>0 || ffs_n>0 || split_n>0 || slide_dir>=0 || testing || linear)) {
+      printf("* checkpoint= and restart= can't be used with replicas, sweep, phase, ffs,\n"
+	    "  split, slide, testing or linear; ignoring them.\n");
+      checkpoint_file=restart_file=NULL;
+   }
+   slide_live=MIN(slide_live,(1<<max_P)/2);
    //if (XXX) {
    //   if (size*block > 800) block=800/size;
    //   if (block==0) { size=512; block=1; size_P=9; }
@@ -1033,28 +1273,35 @@ void getargs(int argc, char **argv)
 
 }
 
-void write_datalines(FILE *out, char *text)
+/* one line per flake of tube tp, or for flake f alone if text is "" */
+void write_tube_datalines(FILE *out, tube *tp, flake *f, char *text)
 { flake *fpp; int perimeter; double dG_bonds;  
 
    for (fpp=tp->flake_list; fpp!=NULL; fpp=fpp->next_flake) {
-      if (strcmp(text,"")==0) fpp=fp;
-      perimeter=calc_perimeter(fpp);
-      dG_bonds = calc_dG_bonds(fpp);
+      if (strcmp(text,"")==0) fpp=f;
+      if (check_stats) check_flake_stats(fpp);
+      perimeter=fpp->perimeter;
+      dG_bonds = fpp->dG_bonds;
       if (tp->hydro) fprintf(out, " %f %f %f %f %f %f %f %f %f ",
 	    Gseh, Gmch, Ghyd, Gas, Gam, Gae, Gah, Gao, Gfc);
       fprintf(out, " %f %f %f %f %d %d %lld %d %f %f%s",
-	    Gmc,tp->Gse,ratek,tp->t,fpp->tiles,fpp->mismatches,tp->events,
+	    tp->Gmc,tp->Gse,ratek,tp->t,fpp->tiles,fpp->mismatches,tp->events,
 	    perimeter, fpp->G, dG_bonds,text);
       if (strcmp(text,"")==0) break;
    }
    fflush(out);
 }
 
+void write_datalines(FILE *out, char *text)
+{
+   write_tube_datalines(out,tp,fp,text);
+}
+
 void write_largeflakedata(FILE *filep) {
-   flake *fp;
+   int n;
    int large_flakes = 0;
-   for (fp = tp->flake_list; fp != NULL; fp=fp->next_flake) {
-      if (fp->tiles > tthresh) {
+   for (n = 0; n < tp->num_flakes; n++) {
+      if (tp->flakes[n]->tiles > tthresh) {
 	 large_flakes++;
       }
    }
@@ -1066,7 +1313,7 @@ void write_untiltilescountdata(FILE *filep) {
 }
 
 void write_flake(FILE *filep, char *mode, flake *fp)
-{ int n, row, col, tl; 
+{ int n, row, col, tl, i0=0, i1=size-1, j0=0, j1=size-1; 
 
    if (filep!=NULL) {
       if (strcmp(mode,"flake")==0) n=export_flake_n++;
@@ -1078,12 +1325,17 @@ void write_flake(FILE *filep, char *mode, flake *fp)
       for (tl=1; tl<=tp->N; tl++) 
 	 fprintf(filep," %8.5f", (tp->conc[tl]>0)?-log(tp->conc[tl]):0 );
       fprintf(filep," ],...\n  [");
-      for (row=0; row<size; row++) {
-	 for (col=0; col<size; col++)
+      if (export_box) {
+	 flake_box(fp,0,&i0,&i1,&j0,&j1);
+	 if (i0>i1) { i1=i0; j1=j0; }  /* no tiles: a single empty cell */
+      }
+      for (row=i0; row<=i1; row++) {
+	 for (col=j0; col<=j1; col++)
 	    fprintf(filep, " %d", fp->Cell(row,col));
 	 fprintf(filep, "; ...\n");
       }
-      fprintf(filep," ] };\n\n");
+      if (export_box) fprintf(filep," ],...\n  [ %d %d ] };\n\n",i0,j0);
+      else fprintf(filep," ] };\n\n");
       fflush(filep);
    }
 }  
@@ -1384,9 +1636,10 @@ void import_flake(flake *current_flake, FILE *flake_file, int flake_number)
 }
 
 
-void closeargs()
+/* the end of the run for tp: fix-ups, then its lines in the output files */
+void write_results()
 { 
-   int i;  flake *fpp;
+   flake *fpp;
 
    // cleans all flakes  (removes "temporary" tiles on growth edge)
    for (fpp=tp->flake_list; fpp!=NULL; fpp=fpp->next_flake) 
@@ -1407,27 +1660,47 @@ void closeargs()
 	 error_radius_flake(fpp,error_radius); 
    }
 
-   /* output information for *all* flakes */
-   if (datafp!=NULL) {
-      write_datalines(datafp,"\n"); fclose(datafp);
-   } 
-
-   if (largeflakefp!=NULL) {
-      write_largeflakedata(largeflakefp); fclose(largeflakefp);
-   }
-
-   if (untiltilescountfp!=NULL) {
-      write_untiltilescountdata(untiltilescountfp);
-      fclose(untiltilescountfp);
-   }
+   if (tp->freeze>0) 
+      fprintf(stderr,"freeze: about %g of %llu events were left out\n",
+	    tp->frozen_missed,tp->events);
+   if (tp->flicker>0) 
+      fprintf(stderr,"flicker: %llu of %llu events were attach/detach round trips done at once\n",
+	    2*tp->flickers,tp->events);
+   if (tp->atam>0 && tp->atam_nondet>0)
+      fprintf(stderr,"atam: %llu sites had a choice of tile types when filled; the first was\n"
+	    "  %d,%d of flake %d, which could take %d or %d\n", tp->atam_nondet,
+	    tp->atam_nd_i,tp->atam_nd_j,tp->atam_nd_flake,tp->atam_nd_n[0],tp->atam_nd_n[1]);
+   else if (tp->atam>0)
+      fprintf(stderr,"atam: every site had just one tile type that could go there\n");
+   if (tp->validate>0) 
+      fprintf(stderr,"validate: %d recounts found %llu discrepancies\n",
+	    tp->validate_runs,tp->validate_bad);
+
+   /* output information for *all* flakes (a sweep or phase= has done this already) */
+   if (datafp!=NULL && sweep_n==0 && phase_n==0) write_datalines(datafp,"\n");
+   if (largeflakefp!=NULL) write_largeflakedata(largeflakefp);
+   if (untiltilescountfp!=NULL) write_untiltilescountdata(untiltilescountfp);
    if (arrayfp!=NULL) {
-      export_flake_n=1;
       for (fpp=tp->flake_list; fpp!=NULL; fpp=fpp->next_flake) {
 	 write_flake(arrayfp, "flake", fpp);
       }
-      fclose(arrayfp);
    }
+}
+
+void closeargs()
+{ 
+   int i;
+
+   if (replicas==1 && sweep_n==0) export_flake_n=1;  /* else numbered across replicas */
+   write_results();
+   if (datafp!=NULL) fclose(datafp);
+   if (largeflakefp!=NULL) fclose(largeflakefp);
+   if (untiltilescountfp!=NULL) fclose(untiltilescountfp);
+   if (arrayfp!=NULL) fclose(arrayfp);
    if (export_fp!=NULL) fclose(export_fp);
+   if (slidefp!=NULL) { write_slide_windows(tp); fclose(slidefp); }
+   if (ffsfp!=NULL) fclose(ffsfp);
+   if (phasefp!=NULL) fclose(phasefp);
 
    // free memory
    for (i=0;i<=tp->N;i++) free(tileb[i]);
@@ -1467,14 +1740,28 @@ void closeargs()
 void showpic(flake *fp, int err) /* display the field */  // err param is ignored!
 {int row,col,i1,i2,color,j,j1,j2,blocktop=block;
    char *picture=(*spinimage).data; static int last_display_type=0;
+   static int shown_i0=0, shown_i1=-1, shown_j0=0, shown_j1=-1;
+   int r0,r1,c0,c1;
    int new_display=(last_display_type!=(10*errors+errorc)); 
    last_display_type=(10*errors+errorc); // re-draw everything when colormap changes
 
+   // beyond one cell from the flake everything is background, so only the
+   // flake's box and whatever the last call drew there need redrawing.
+   flake_box(fp,1,&r0,&r1,&c0,&c1);
+   if (showpic_full || new_display) { r0=c0=0; r1=c1=size-1; }
+   else if (shown_i0<=shown_i1) {
+      if (r0>r1) { r0=shown_i0; r1=shown_i1; c0=shown_j0; c1=shown_j1; }
+      else { r0=MIN(r0,shown_i0); r1=MAX(r1,shown_i1); 
+	 c0=MIN(c0,shown_j0); c1=MAX(c1,shown_j1); }
+   }
+   flake_box(fp,1,&shown_i0,&shown_i1,&shown_j0,&shown_j1);
+   showpic_full=0;
+
    if (block>4) blocktop=block-1;  
    if (8==(*spinimage).depth) {
       if (block>1) /* I wish I knew how to do this faster */
-	 for (row=0;row<size;row++)
-	    for (col=0;col<size;col++) {
+	 for (row=r0;row<=r1;row++)
+	    for (col=c0;col<=c1;col++) {
 	       color = getcolor(row,col);
 	       j=block*((col+NBDY)+block*NCOLS*(row+NBDY));
 	       if (color!=picture[j] || new_display) {
@@ -1490,14 +1777,14 @@ void showpic(flake *fp, int err) /* display the field */  // err param is ignore
 			int ncolm=fp->Cell(row,col-1),  ncolp=fp->Cell(row,col+1);  
 			int nrowm=fp->Cell(row-1,col),  nrowp=fp->Cell(row+1,col);  
 			Ccolm=weakcolor; Ccolp=weakcolor; Crowp=weakcolor; Crowm=weakcolor;
-			if (fp->tube->Gse_EW[ n ] [ ncolm ] > 1.5*Gse) Ccolm=strongcolor;
-			if (fp->tube->Gse_EW[ ncolp ] [ n ] > 1.5*Gse) Ccolp=strongcolor;
-			if (fp->tube->Gse_NS[ n ] [ nrowp ] > 1.5*Gse) Crowp=strongcolor;
-			if (fp->tube->Gse_NS[ nrowm ] [ n ] > 1.5*Gse) Crowm=strongcolor;
-			if (fp->tube->Gse_EW[ n ] [ ncolm ] < 0.5*Gse) Ccolm=nullcolor;
-			if (fp->tube->Gse_EW[ ncolp ] [ n ] < 0.5*Gse) Ccolp=nullcolor;
-			if (fp->tube->Gse_NS[ n ] [ nrowp ] < 0.5*Gse) Crowp=nullcolor;
-			if (fp->tube->Gse_NS[ nrowm ] [ n ] < 0.5*Gse) Crowm=nullcolor;
+			if (Gse_EW(fp->tube, n, ncolm) > 1.5*Gse) Ccolm=strongcolor;
+			if (Gse_EW(fp->tube, ncolp, n) > 1.5*Gse) Ccolp=strongcolor;
+			if (Gse_NS(fp->tube, n, nrowp) > 1.5*Gse) Crowp=strongcolor;
+			if (Gse_NS(fp->tube, nrowm, n) > 1.5*Gse) Crowm=strongcolor;
+			if (Gse_EW(fp->tube, n, ncolm) < 0.5*Gse) Ccolm=nullcolor;
+			if (Gse_EW(fp->tube, ncolp, n) < 0.5*Gse) Ccolp=nullcolor;
+			if (Gse_NS(fp->tube, n, nrowp) < 0.5*Gse) Crowp=nullcolor;
+			if (Gse_NS(fp->tube, nrowm, n) < 0.5*Gse) Crowm=nullcolor;
 		     }
 		     if (n==0 && fp->Cell(row,col-1)==0) Ccolm=translate[0];
 		     if (n==0 && fp->Cell(row,col+1)==0) Ccolp=translate[0];
@@ -1515,14 +1802,14 @@ void showpic(flake *fp, int err) /* display the field */  // err param is ignore
 	       }
 	    }
       else { 
-	 for (row=0,j=NCOLS*NBDY+NBDY;row<size;row++,j+=2*NBDY) 
-	    for (col=0;col<size;col++,j++)
+	 for (row=r0;row<=r1;row++) 
+	    for (col=c0,j=NCOLS*(row+NBDY)+c0+NBDY;col<=c1;col++,j++)
 	       picture[j]=getcolor(row,col);
       }
    } else {/* depth is not == 8, use xputpixel (this is really ugly) */
       if (block>1) /* I wish I knew how to do this faster */
-	 for (row=0;row<size;row++)
-	    for (col=0;col<size;col++) {
+	 for (row=r0;row<=r1;row++)
+	    for (col=c0;col<=c1;col++) {
 	       color=getcolor(row,col);
 	       if (color!=XGetPixel(spinimage,j1=block*(col+NBDY),j2=block*(row+NBDY)) 
 		     || new_display) {
@@ -1537,14 +1824,14 @@ void showpic(flake *fp, int err) /* display the field */  // err param is ignore
 			   int ncolm=fp->Cell(row,col-1),  ncolp=fp->Cell(row,col+1);  
 			   int nrowm=fp->Cell(row-1,col),  nrowp=fp->Cell(row+1,col);  
 			   Ccolm=weakcolor; Ccolp=weakcolor; Crowp=weakcolor; Crowm=weakcolor;
-			   if (fp->tube->Gse_EW[ n ] [ ncolm ] > 1.5*Gse) Ccolm=strongcolor;
-			   if (fp->tube->Gse_EW[ ncolp ] [ n ] > 1.5*Gse) Ccolp=strongcolor;
-			   if (fp->tube->Gse_NS[ n ] [ nrowp ] > 1.5*Gse) Crowp=strongcolor;
-			   if (fp->tube->Gse_NS[ nrowm ] [ n ] > 1.5*Gse) Crowm=strongcolor;
-			   if (fp->tube->Gse_EW[ n ] [ ncolm ] < 0.5*Gse) Ccolm=nullcolor;
-			   if (fp->tube->Gse_EW[ ncolp ] [ n ] < 0.5*Gse) Ccolp=nullcolor;
-			   if (fp->tube->Gse_NS[ n ] [ nrowp ] < 0.5*Gse) Crowp=nullcolor;
-			   if (fp->tube->Gse_NS[ nrowm ] [ n ] < 0.5*Gse) Crowm=nullcolor;
+			   if (Gse_EW(fp->tube, n, ncolm) > 1.5*Gse) Ccolm=strongcolor;
+			   if (Gse_EW(fp->tube, ncolp, n) > 1.5*Gse) Ccolp=strongcolor;
+			   if (Gse_NS(fp->tube, n, nrowp) > 1.5*Gse) Crowp=strongcolor;
+			   if (Gse_NS(fp->tube, nrowm, n) > 1.5*Gse) Crowm=strongcolor;
+			   if (Gse_EW(fp->tube, n, ncolm) < 0.5*Gse) Ccolm=nullcolor;
+			   if (Gse_EW(fp->tube, ncolp, n) < 0.5*Gse) Ccolp=nullcolor;
+			   if (Gse_NS(fp->tube, n, nrowp) < 0.5*Gse) Crowp=nullcolor;
+			   if (Gse_NS(fp->tube, nrowm, n) < 0.5*Gse) Crowm=nullcolor;
 			}
 			if (n==0 && fp->Cell(row,col-1)==0) Ccolm=translate[0];
 			if (n==0 && fp->Cell(row,col+1)==0) Ccolp=translate[0];
@@ -1559,8 +1846,8 @@ void showpic(flake *fp, int err) /* display the field */  // err param is ignore
 	       }
 	    }
       else
-	 for (row=0;row<size;row++)
-	    for (col=0;col<size;col++) {
+	 for (row=r0;row<=r1;row++)
+	    for (col=c0;col<=c1;col++) {
 	       color = getcolor(row,col);
 	       XPutPixel(spinimage,col+NBDY,row+NBDY,color);
 	    }
@@ -1583,6 +1870,7 @@ void add_sample_pic(flake *fp, int err) /* add sample the field */
    // this gets a di, dj
    XDrawImageString(display,samplebutton,gcr,0,font_height,"  SAMPLING   ",13);
    XPutImage(display,playground,gc,spinimage,0,0,0,0,block*NCOLS,block*NROWS); 
+   showpic_full=1;
 
    for (n=1; n<n_tries && (collision==1 || anything==0); n++) {
       di= random()%(2*size-1) - size;
@@ -1634,6 +1922,7 @@ void add_sample_pic(flake *fp, int err) /* add sample the field */
 void showphase() /* replace tiles by phase diagram T=1 & T=2 lines */
 {int row,col,color,i1,i2,j1,j2,blocktop=block;
    if (block>4) blocktop=block-1;
+   showpic_full=1;
    for (row=0;row<size;row++)
       for (col=0;col<size;col++) {
 	 color = ((size-row)/2==col || (size-row)==col) ?
@@ -2071,6 +2360,245 @@ void cleanup()
 } 
 
 
+/* a tube as the options say, with its starting flakes; each gets the */
+/* next substream of main_rng                                         */
+tube *make_tube()
+{
+   tube *tp = init_tube(size_P,N,num_bindings);   
+   flake *fp = NULL;
+   tp->max_P = max_P;  tp->freeze = freeze;  tp->flicker = flicker;
+   tp->atam = atam;  tp->validate = validate;
+   rng_split(&main_rng,&tp->rng);
+   set_params(tp,tileb,strength,glue,stoic,anneal_g,anneal_t,updates_per_RC,anneal_h,anneal_s,startC,endC,seconds_per_C,dt_right, dt_left, dt_down, dt_up, hydro,ratek,
+	 Gmc,Gse,Gmch,Gseh,Ghyd,Gas,Gam,Gae,Gah,Gao,T,tinybox,seed_i,seed_j,Gfc);
+
+   fprm=fparam;
+
+
+   /* initialize flakes */
+   while (fprm!=NULL)
+   {
+      int fn;
+      for (fn=1; fn <= fprm->N; fn++)
+      {
+	 if (tp->dt_left[fprm->seed_n]) {
+	    fprm->seed_n = tp->dt_left[fprm->seed_n]; // FIXME: vdouble
+	    fprm->seed_j--;
+	 }
+	 insert_flake(fp=init_flake(size_P,N,
+		  fprm->seed_i,fprm->seed_j,fprm->seed_n,fprm->Gfc), tp);
+	 if (tp->dt_right[fprm->seed_n]) {
+	    change_cell (fp,seed_i,seed_j+1,tp->dt_right[fprm->seed_n]);
+	    fp->seed_is_double_tile = 1;
+	 }
+	 assert (!tp->dt_left[fprm->seed_n]);
+	 if (tp->dt_down[fprm->seed_n]) {
+	    change_cell (fp,seed_i+1,seed_j,tp->dt_down[fprm->seed_n]);
+	    fp->seed_is_vdouble_tile = 1;
+	 }
+	 assert (!tp->dt_up[fprm->seed_n]);
+
+
+	 if (fprm->import_from != NULL)
+	 {
+	    fprintf(stderr, "WARNING: In imported flakes, the seed position is chosen randomly.\n");
+	    import_flake(fp, fprm->import_from, fn);
+	 }
+      }
+      fprm=fprm->next_param;
+   }
+   return tp;
+}
+
+/* the limits the run stops at */
+int keep_going(tube *tp)
+{
+   return (tmax==0 || tp->t < tmax) && 
+      (emax==0 || tp->events < emax) &&
+      (smax==0 || tp->stat_a-tp->stat_d < smax) &&
+      (mmax==0 || tp->stat_m < mmax) &&
+      (smin==-1 || tp->stat_a-tp->stat_d > smin) &&
+      (fsmax==0 || tp->largest_flake_size < fsmax) &&
+      (tp->seconds_per_C == 0 || tp->currentC > tp->endC) &&
+      !(untiltiles && tp->all_present) &&
+      !(tp->atam && tp->atam_n==tp->atam_head);  /* terminal assembly [atam] */
+}
+
+/* [sweep] a warmstart sweep is a few chains of conditions, each run   */
+/* by one tube in turn; otherwise each condition is a chain of its own  */
+int sweep_chains()
+{
+   if (sweep_n==0) return 1;
+   if (sweep_warm) return (sweep_m>0) ? sweep_n : 1;
+   return (sweep_m>0) ? sweep_n*sweep_m : sweep_n;
+}
+
+int sweep_length()
+{
+   int n = (sweep_m>0) ? sweep_m : sweep_n;
+   if (!sweep_warm) return 1;
+   return sweep_back ? 2*n-1 : n;
+}
+
+/* the k-th condition of chain c */
+void sweep_point(int c, int k, double *gmc, double *gse)
+{
+   int a, b, n=sweep_n, m=sweep_m;
+   if (m==0) {  /* along the path */
+      a = sweep_warm ? ((k<n) ? k : 2*(n-1)-k) : c;
+      *gmc = sweep_gmc[0] + (n>1 ? (sweep_gmc[1]-sweep_gmc[0])*a/(n-1) : 0);
+      *gse = sweep_gse[0] + (n>1 ? (sweep_gse[1]-sweep_gse[0])*a/(n-1) : 0);
+   } else {     /* on the grid, Gmc by Gse */
+      if (sweep_warm) { a = c;  b = (k<m) ? k : 2*(m-1)-k; }
+      else { a = c/m;  b = c%m; }
+      *gmc = sweep_gmc[0] + (n>1 ? (sweep_gmc[1]-sweep_gmc[0])*a/(n-1) : 0);
+      *gse = sweep_gse[0] + (m>1 ? (sweep_gse[1]-sweep_gse[0])*b/(m-1) : 0);
+   }
+}
+
+/* new conditions for the flakes as they are, as when they're changed */
+/* in the window                                                      */
+void sweep_to(tube *rp, double gmc, double gse)
+{
+   int stat_m = rp->stat_m;
+   reset_params(rp, rp->Gmc, rp->Gse, gmc, gse, Gseh);
+   if (rp->initial_Gfc>0) rp->initial_Gfc += gmc-rp->Gmc;
+   rp->Gmc = gmc;  rp->Gse = gse;  rp->stat_m = stat_m;
+}
+
+/* [replicas] each thread takes the next job (a replica, or a replica */
+/* of a sweep chain) not yet run until none are left; trace and sweep */
+/* data lines go to buffers per job, for main to write out in order.  */
+tube **reps;  int jobs;
+char **rep_trace, **rep_data;  size_t *rep_trace_len, *rep_data_len;
+int next_rep=0;  pthread_mutex_t rep_lock=PTHREAD_MUTEX_INITIALIZER;
+
+void run_tube(tube *rp, FILE *trace)
+{
+   if (trace!=NULL) write_tube_datalines(trace,rp,rp->flake_list,"\n");
+   while (keep_going(rp)) {
+      simulate(rp,update_rate,tmax,emax,smax,fsmax,smin,mmax);
+      if (trace!=NULL) write_tube_datalines(trace,rp,rp->flake_list,"\n");
+   }
+}
+
+void *run_replicas(void *arg)
+{
+   int r, k;  FILE *trace, *data;  tube *rp;  double gmc, gse;
+   for (;;) {
+      pthread_mutex_lock(&rep_lock);  r = next_rep++;  pthread_mutex_unlock(&rep_lock);
+      if (r >= jobs) break;
+      rp = reps[r];  trace = data = NULL;
+      if (tracefp!=NULL) trace = open_memstream(&rep_trace[r],&rep_trace_len[r]);
+      if (sweep_n==0) run_tube(rp,trace);
+      else {
+	 if (datafp!=NULL) data = open_memstream(&rep_data[r],&rep_data_len[r]);
+	 for (k=0; k<sweep_length(); k++) {
+	    sweep_point(r/replicas,k,&gmc,&gse);
+	    sweep_to(rp,gmc,gse);
+	    rp->t = 0;  rp->events = 0;
+	    run_tube(rp,trace);
+	    if (data!=NULL) write_tube_datalines(data,rp,rp->flake_list,"\n");
+	 }
+	 if (data!=NULL) fclose(data);
+      }
+      if (trace!=NULL) fclose(trace);
+   }
+   free_pools();
+   return NULL;
+}
+
+/* [phase] net tiles per second in one burst from the starting state s0 */
+/* at (gmc,gse); rp->Gmc and initial_Gfc are put back to the starting   */
+/* gmc0, gfc0 first, since restore_tube puts back conc[] as it was then. */
+double phase_burst(tube *rp, tube_state *s0, double gmc0, double gfc0, double gmc, double gse)
+{
+   double dt = (phase_time>0) ? phase_time : 20*exp(gmc)/rp->k;
+   int tiles0=0, tiles1=0;  flake *fpp;
+   restore_tube(rp,s0);
+   rp->Gmc = gmc0;  rp->initial_Gfc = gfc0;
+   sweep_to(rp,gmc,gse);
+   for (fpp=rp->flake_list; fpp!=NULL; fpp=fpp->next_flake) tiles0 += fpp->tiles;
+   rp->t = 0;  rp->events = 0;
+   while (rp->t < dt) simulate(rp,1ULL<<40,dt,0,0,0,-1,0);
+   for (fpp=rp->flake_list; fpp!=NULL; fpp=fpp->next_flake) tiles1 += fpp->tiles;
+   return (tiles1-tiles0)/rp->t;
+}
+
+/* +1 if flakes grow at (gmc,gse), -1 if they melt, 0 if 4x phase_samples */
+/* bursts can't tell; the measurement goes to out                         */
+int phase_sign(tube *rp, tube_state *s0, double gmc0, double gfc0, 
+      double gmc, double gse, int *bursts, FILE *out)
+{
+   int n=0, want=phase_samples;  double r, sum=0, sum2=0, mean=0, se=0;
+   for (;;) {
+      for (; n<want; n++) {
+	 r = phase_burst(rp,s0,gmc0,gfc0,gmc,gse);  sum += r;  sum2 += r*r;
+      }
+      mean = sum/n;  se = sqrt(MAX(0,sum2/n-mean*mean)/(n-1));
+      if (fabs(mean) > 2*se || want >= 4*phase_samples) break;
+      want *= 2;
+   }
+   *bursts += n;
+   if (out!=NULL) fprintf(out,"%f %f %g %g %d\n",gmc,gse,mean,se,n);
+   return (mean > 2*se) - (mean < -2*se);
+}
+
+/* [phase] each thread takes the next Gmc and bisects on Gse; the      */
+/* boundary goes in phase_edge[] as Gse, bracket, bursts and the Gse   */
+/* whose sign didn't settle (NAN if none; then Gse is NAN too), and    */
+/* measurements in rep_data buffers                                    */
+tube_state *phase_s0;  double (*phase_edge)[5];
+
+void *run_phase(void *arg)
+{
+   int r, s, bursts;  FILE *data;  tube *rp;
+   double gmc, gmc0, gfc0, lo, hi, g, unclear;
+   for (;;) {
+      pthread_mutex_lock(&rep_lock);  r = next_rep++;  pthread_mutex_unlock(&rep_lock);
+      if (r >= jobs) break;
+      rp = reps[r];  data = NULL;  bursts = 0;
+      gmc0 = rp->Gmc;  gfc0 = rp->initial_Gfc;
+      if (datafp!=NULL) data = open_memstream(&rep_data[r],&rep_data_len[r]);
+      gmc = phase_gmc[0] + (jobs>1 ? (phase_gmc[1]-phase_gmc[0])*r/(jobs-1) : 0);
+      lo = phase_gse[0];  hi = phase_gse[1];  g = NAN;  unclear = NAN;
+      if ((s = phase_sign(rp,phase_s0,gmc0,gfc0,gmc,lo,&bursts,data)) == 0) unclear = lo;
+      else if (s < 0) {
+	 if ((s = phase_sign(rp,phase_s0,gmc0,gfc0,gmc,hi,&bursts,data)) == 0) unclear = hi;
+	 else if (s > 0) {
+	    while (hi-lo > phase_tol) {
+	       g = (lo+hi)/2;
+	       if ((s = phase_sign(rp,phase_s0,gmc0,gfc0,gmc,g,&bursts,data)) == 0) break;
+	       if (s>0) hi=g; else lo=g;
+	    }
+	    if (hi-lo <= phase_tol) g = (lo+hi)/2;
+	    else { unclear = g;  g = NAN; }
+	 }
+      }
+      phase_edge[r][0] = g;  phase_edge[r][1] = lo;  phase_edge[r][2] = hi;
+      phase_edge[r][3] = bursts;  phase_edge[r][4] = unclear;
+      if (data!=NULL) fclose(data);
+   }
+   free_pools();
+   return NULL;
+}
+
+/* [checkpoint] SIGUSR1 asks for one at the end of the current batch */
+void checkpoint_signal(int sig)
+{
+   checkpoint_now=1;
+}
+
+/* between batches of events, write a checkpoint if one is due */
+void checkpoint_due(int force)
+{
+   if (checkpoint_file==NULL) return;
+   if (force || checkpoint_now || difftime(time(NULL),checkpoint_last) >= checkpoint_every) {
+      checkpoint_now=0;  checkpoint_last=time(NULL);
+      write_checkpoint(tp,checkpoint_file);
+   }
+}
+
 int main(int argc, char **argv)
 {
    int x,y,b,i,j;    int clear_x=0,clear_y=0;
@@ -2110,6 +2638,7 @@ int main(int argc, char **argv)
 
    if (testing) {
       tp = init_tube(size_P,N,num_bindings);   
+      rng_split(&main_rng,&tp->rng);
       set_params(tp,tileb,strength,glue,stoic,0,initial_rc,updates_per_RC,
 	    anneal_h,anneal_s,startC,endC,seconds_per_C,
 	    dt_right, dt_left, dt_down, dt_up, hydro,ratek,
@@ -2125,47 +2654,14 @@ int main(int argc, char **argv)
    /* printf("xgrow: tile set read, beginning simulation\n"); */
 
    /* set initial state */
-   tp = init_tube(size_P,N,num_bindings);   
-   set_params(tp,tileb,strength,glue,stoic,anneal_g,anneal_t,updates_per_RC,anneal_h,anneal_s,startC,endC,seconds_per_C,dt_right, dt_left, dt_down, dt_up, hydro,ratek,
-	 Gmc,Gse,Gmch,Gseh,Ghyd,Gas,Gam,Gae,Gah,Gao,T,tinybox,seed_i,seed_j,Gfc);
-
-   fprm=fparam;
-
-
-   /* initialize flakes */
-   while (fprm!=NULL)
-   {
-      int fn;
-      for (fn=1; fn <= fprm->N; fn++)
-      {
-	 if (tp->dt_left[fprm->seed_n]) {
-	    fprm->seed_n = tp->dt_left[fprm->seed_n]; // FIXME: vdouble
-	    fprm->seed_j--;
-	 }
-	 insert_flake(fp=init_flake(size_P,N,
-		  fprm->seed_i,fprm->seed_j,fprm->seed_n,fprm->Gfc), tp);
-	 if (tp->dt_right[fprm->seed_n]) {
-	    change_cell (fp,seed_i,seed_j+1,tp->dt_right[fprm->seed_n]);
-	    fp->seed_is_double_tile = 1;
-	 }
-	 assert (!tp->dt_left[fprm->seed_n]);
-	 if (tp->dt_down[fprm->seed_n]) {
-	    change_cell (fp,seed_i+1,seed_j,tp->dt_down[fprm->seed_n]);
-	    fp->seed_is_vdouble_tile = 1;
-	 }
-	 assert (!tp->dt_up[fprm->seed_n]);
-
-
-	 if (fprm->import_from != NULL)
-	 {
-	    fprintf(stderr, "WARNING: In imported flakes, the seed position is chosen randomly.\n");
-	    import_flake(fp, fprm->import_from, fn);
-	 }
-      }
-      fprm=fprm->next_param;
+   tp = make_tube();
+   fp = tp->flake_list;
+   if (slide_dir>=0) {
+      if (slidefp==NULL) slidefp=fopen("xgrow_slide_output","w");
+      tp->slide_dir = slide_dir;  tp->slide_live = slide_live;  tp->slide_fp = slidefp;
    }
 
-   //   print_tree(tp->flake_tree,0,'*'); 
+   //   print_tree(tp); 
 
    if (stripe_args!=NULL) {
       /* STRIPE OPTION HAS HARDCODED TILESET NONSENSE -- A BUG */
@@ -2174,7 +2670,7 @@ int main(int argc, char **argv)
       char XOR[2][2]={ {4,7}, {6,5} }; /* XOR[S][E] */ char c,cc;
       i=size-1; j = atoi(s)%size; 
       for (k=0; k<size; k++) 
-	 change_cell(fp, (i-k+size)%size, (j+k)%size, 4+random()%4); 
+	 change_cell(fp, (i-k+size)%size, (j+k)%size, 4+rng_int(&tp->rng,4)); 
       fp->seed_i=i; fp->seed_j=j; fp->seed_n=fp->Cell(i,j);
       s = strchr(s,':');
       while (s!=NULL) {
@@ -2186,7 +2682,7 @@ int main(int argc, char **argv)
 	       for (k=0; k<size; k++) {
 		  cc=c= XOR[(fp->Cell((i-k+1+size)%size,(j+k)%size)-4)/2]
 		     [(fp->Cell((i-k+size)%size,(j+k+1)%size)-4)/2];
-		  if (drand48()<p) do cc=4+random()%4; while (cc==c);
+		  if (rng_uniform(&tp->rng)<p) do cc=4+rng_int(&tp->rng,4); while (cc==c);
 		  change_cell(fp, (i-k+size)%size, (j+k)%size, cc);
 		  tp->events--; /* don't count these as events */
 		  /* ERROR: stats are also modified!!! */
@@ -2198,11 +2694,47 @@ int main(int argc, char **argv)
       tp->conc[0] -= tp->conc[1]; tp->conc[0]+=(tp->conc[1]=exp(-35));
       tp->conc[0] -= tp->conc[2]; tp->conc[0]+=(tp->conc[2]=exp(-35));
       tp->conc[0] -= tp->conc[3]; tp->conc[0]+=(tp->conc[3]=exp(-35));
+      reset_conc_trees(tp);
    }
 
 
+   if (restart_file!=NULL) {  /* [checkpoint] the run goes on from there */
+      if (!read_checkpoint(tp,restart_file)) exit(1);
+      fp=tp->flake_list;  size_P=tp->P;  size=(1<<size_P);
+      Gse=tp->Gse;  Gmc=tp->Gmc;
+   }
+   if (checkpoint_file!=NULL) {
+      checkpoint_last=time(NULL);
+      signal(SIGUSR1,checkpoint_signal);
+   }
+
    // printf("flake initialized, size_P=%d, size=%d\n",size_P,size);
 
+   if (ffs_n>0) {  /* [ffs] instead of the usual run */
+      tube **wk = (tube **) calloc(threads,sizeof(tube *));
+      if (ffsfp==NULL) ffsfp=fopen("xgrow_ffs_output","w");
+      wk[0] = tp;
+      for (i=1; i<threads; i++) wk[i] = make_tube();
+      ffs_simulate(wk,threads,threads,ffs_n,ffs_ifc,ffs_trials,ffs_time,ffsfp);
+      for (i=1; i<threads; i++) free_tube(wk[i]);
+      free(wk);
+      fp=tp->flake_list;
+      closeargs();
+      return 0;
+   }
+
+   if (split_n>0) {  /* [split] instead of the usual run */
+      tube **wk = (tube **) calloc(threads,sizeof(tube *));
+      wk[0] = tp;
+      for (i=1; i<threads; i++) wk[i] = make_tube();
+      split_simulate(wk,threads,threads,split_n,split_dt,tmax);
+      for (i=1; i<threads; i++) free_tube(wk[i]);
+      free(wk);
+      fp=tp->flake_list;
+      closeargs();
+      return 0;
+   }
+
    new_Gse=Gse; new_Gmc=Gmc;
    if (tracefp!=NULL) write_datalines(tracefp,"\n");
 
@@ -2211,21 +2743,99 @@ int main(int argc, char **argv)
 
    if (XXX) repaint();
 
+   if (phase_n>0) {  /* [phase] instead of the usual run */
+      pthread_t *pool;  double gfc0;
+      jobs = phase_n;
+      pool = (pthread_t *) calloc(MIN(threads,jobs),sizeof(pthread_t));
+      reps = (tube **) calloc(jobs,sizeof(tube *));
+      rep_data = (char **) calloc(jobs,sizeof(char *));
+      rep_data_len = (size_t *) calloc(jobs,sizeof(size_t));
+      phase_edge = (double (*)[5]) calloc(jobs,sizeof(double[5]));
+      if (tmax>0 || emax>0 || smax>0 || mmax>0 || fsmax>0 || smin>-1)
+	 while (keep_going(tp)) simulate(tp,update_rate,tmax,emax,smax,fsmax,smin,mmax);
+      phase_s0 = save_tube(tp);  gfc0 = tp->initial_Gfc;
+      reps[0] = tp;
+      for (i=1; i<jobs; i++) reps[i] = make_tube();
+      for (i=0; i<MIN(threads,jobs); i++) 
+	 pthread_create(&pool[i],NULL,run_phase,NULL);
+      for (i=0; i<MIN(threads,jobs); i++) pthread_join(pool[i],NULL);
+      if (phasefp==NULL) phasefp=fopen("xgrow_phase_output","w");
+      for (i=0; i<jobs; i++) {
+	 double gmc = phase_gmc[0] + (jobs>1 ? (phase_gmc[1]-phase_gmc[0])*i/(jobs-1) : 0);
+	 if (rep_data[i]!=NULL) {
+	    fwrite(rep_data[i],1,rep_data_len[i],datafp);  free(rep_data[i]);
+	 }
+	 if (!isnan(phase_edge[i][4])) {
+	    printf("phase: Gmc=%g: unresolved, between Gse=%g and %g; the sign at %g didn't"
+		  " settle (%d bursts)\n", gmc, phase_edge[i][1], phase_edge[i][2],
+		  phase_edge[i][4], (int)phase_edge[i][3]);
+	    if (phasefp!=NULL) fprintf(phasefp,"%f nan %f %f %d\n", gmc,
+		  phase_edge[i][1], phase_edge[i][2], (int)phase_edge[i][3]);
+	 }
+	 else if (isnan(phase_edge[i][0]))
+	    printf("phase: Gmc=%g: no change of sign from Gse=%g (melting) to %g (growing)"
+		  " (%d bursts)\n", gmc, phase_gse[0], phase_gse[1], (int)phase_edge[i][3]);
+	 else {
+	    printf("phase: Gmc=%g: boundary at Gse=%g, between %g and %g (%d bursts)\n",
+		  gmc, phase_edge[i][0], phase_edge[i][1], phase_edge[i][2], 
+		  (int)phase_edge[i][3]);
+	    if (phasefp!=NULL) fprintf(phasefp,"%f %f %f %f %d\n", gmc, phase_edge[i][0],
+		  phase_edge[i][1], phase_edge[i][2], (int)phase_edge[i][3]);
+	 }
+	 if (i>0) free_tube(reps[i]);
+      }
+      restore_tube(tp,phase_s0);  free_tube_state(phase_s0);  /* for the final outputs */
+      tp->Gmc = Gmc;  tp->initial_Gfc = gfc0;  sweep_to(tp,Gmc,Gse);
+      tp->t = 0;  tp->events = 0;
+      fp = tp->flake_list;
+      free(pool); free(reps); free(rep_data); free(rep_data_len); free(phase_edge);
+      closeargs();
+      return 0;
+   }
+
+   if (replicas>1 || sweep_n>0) {  /* [replicas] [sweep] instead of the usual run */
+      pthread_t *pool;
+      jobs = replicas*sweep_chains();
+      pool = (pthread_t *) calloc(MIN(threads,jobs),sizeof(pthread_t));
+      reps = (tube **) calloc(jobs,sizeof(tube *));
+      rep_trace = (char **) calloc(jobs,sizeof(char *));
+      rep_trace_len = (size_t *) calloc(jobs,sizeof(size_t));
+      rep_data = (char **) calloc(jobs,sizeof(char *));
+      rep_data_len = (size_t *) calloc(jobs,sizeof(size_t));
+      reps[0] = tp;
+      for (i=1; i<jobs; i++) reps[i] = make_tube();
+      for (i=0; i<MIN(threads,jobs); i++) 
+	 pthread_create(&pool[i],NULL,run_replicas,NULL);
+      for (i=0; i<MIN(threads,jobs); i++) pthread_join(pool[i],NULL);
+      export_flake_n=1;
+      for (i=0; i<jobs; i++) {
+	 if (rep_trace[i]!=NULL) {
+	    fwrite(rep_trace[i],1,rep_trace_len[i],tracefp);  free(rep_trace[i]);
+	 }
+	 if (rep_data[i]!=NULL) {
+	    fwrite(rep_data[i],1,rep_data_len[i],datafp);  free(rep_data[i]);
+	 }
+	 tp = reps[i];  fp = tp->flake_list;
+	 size_P = tp->P;  size = (1<<size_P);
+	 if (i<jobs-1) { write_results(); free_tube(tp); }
+      }
+      fflush(NULL);
+      free(pool); free(reps); free(rep_trace); free(rep_trace_len);
+      free(rep_data); free(rep_data_len);
+      closeargs();
+      return 0;
+   }
+
    /* loop forever, looking for events */
-   while((tmax==0 || tp->t < tmax) && 
-	 (emax==0 || tp->events < emax) &&
-	 (smax==0 || tp->stat_a-tp->stat_d < smax) &&
-	 (mmax==0 || tp->stat_m < mmax) &&
-	 (smin==-1 || tp->stat_a-tp->stat_d > smin) &&
-	 (fsmax==0 || tp->largest_flake_size < fsmax) &&
-	 (tp->seconds_per_C == 0 || tp->currentC > tp->endC) &&
-	 !(untiltiles && tp->all_present)) { 
+   while(keep_going(tp)) { 
 
       Gse=tp->Gse;  // keep them sync'd in case "anneal" is ongoing.
       if (!XXX) {
 	 simulate(tp,update_rate,tmax,emax,smax,fsmax,smin,mmax);
+	 size_P=tp->P; size=(1<<size_P);  // the field may have grown [maxsize]
 	 if (tracefp!=NULL) write_datalines(tracefp,"\n");
 	 if (export_mode==2 && export_movie==1) export_flake("movie",fp);
+	 checkpoint_due(0);
       } else {
 	 if (0==paused && 0==mousing && !XPending(display)) {
 	    simulate(tp,update_rate,tmax,emax,smax,fsmax,smin,mmax);
@@ -2237,6 +2847,7 @@ int main(int argc, char **argv)
 	    if (fp && fp->flake_conc>0) recalc_G(fp);
 	    // make sure displayed G is accurate for conc's
 	    // hopefully this won't slow things down too much.
+	    checkpoint_due(0);
 	    stat++; if (stat==1) { stat=0; repaint(); }
 	 }
 	 if (paused|mousing|XPending(display)) {
@@ -2339,6 +2950,12 @@ int main(int argc, char **argv)
 	       } else if (report.xbutton.window==restartbutton) {
 		  free_tube(tp); 
 		  tp = init_tube(size_P,N,num_bindings);   
+		  tp->freeze = freeze;  tp->flicker = flicker;
+		  tp->atam = atam;  tp->validate = validate;
+		  if (slide_dir>=0) {
+		     tp->slide_dir = slide_dir;  tp->slide_live = slide_live;  tp->slide_fp = slidefp;
+		  }
+		  rng_split(&main_rng,&tp->rng);
 		  set_params(tp,tileb,strength,glue,stoic,anneal_g,anneal_t,updates_per_RC,
 			anneal_h, anneal_s, startC, endC, seconds_per_C,
 			dt_right, dt_left, dt_down, dt_up, hydro,ratek,
@@ -2459,7 +3076,7 @@ int main(int argc, char **argv)
 			}
 		     }
 		  } 
-		  //             print_tree(tp->flake_tree,0,'*');  
+		  //             print_tree(tp);  
 		  sampling=0; repaint();
 	       } else if (report.xbutton.window==tempbutton) { // change Gse w/ button
 		  x=report.xbutton.x;  
@@ -2506,6 +3123,7 @@ int main(int argc, char **argv)
 	 } /* end of if XPending */
       }} /* end of while(...) if...else */
 
+   checkpoint_due(1);  /* before write_results() cleans and fills the flakes */
    closeargs();
    return 0;
 } /* end of main */